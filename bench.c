@@ -0,0 +1,179 @@
+// Benchmark: renders the bundled models headless along fixed camera paths, with no input, and
+// reports frame time percentiles and throughput as JSON. Built instead of main.c (see README.md).
+
+// For dup, dup2 and fdopen, to keep stdout for the results.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "engine.h"
+
+// Most models given on the command line.
+#define MAX_MODELS 64
+
+// Frames drawn before timing, so the first frames' allocations and cold caches don't count.
+#define WARMUP_FRAMES 10
+
+static const char *_default_models[] = {
+    "models/cube.obj",
+    "models/sphere.obj",
+    "models/capsule.obj",
+    "models/suzanne.obj",
+    "models/Shiba.obj",
+    "models/casa.obj",
+};
+
+static int _compare_floats(const void *a, const void *b) {
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Nearest rank percentile of sorted values.
+static float _percentile(const float *sorted, int n, float p) {
+    int rank = (int)ceilf(p / 100 * n);
+    return sorted[MAX(0, MIN(n - 1, rank - 1))];
+}
+
+// Writes a string as a JSON string (Windows paths have backslashes).
+static void _write_json_string(FILE *json, const char *s) {
+    fputc('"', json);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', json);
+        fputc(*s, json);
+    }
+    fputc('"', json);
+}
+
+// Camera paths around a scene's bounding sphere.
+#define NUM_PATHS 2
+
+static const char *_path_names[NUM_PATHS] = {
+    "orbit", // All the way around, far enough away to see all of it.
+    "dolly", // Straight in from the front, until the scene fills the screen and then some.
+};
+
+static struct CameraPath *_create_path(int path, struct Vector3 center, float radius) {
+    if (path == 0) {
+        return CameraPath_orbit(center, radius * 1.5, radius * 0.5);
+    }
+
+    struct CameraPath *p = CameraPath_create();
+    CameraPath_add(p, Vector3_add(center, Vector3_create_direction(0, radius * 0.5, -radius * 3)), center);
+    CameraPath_add(p, Vector3_add(center, Vector3_create_direction(0, radius * 0.1, -radius * 0.6)), center);
+    return p;
+}
+
+int main(int argc, char *argv[]) {
+    int         width      = 1920;
+    int         height     = 1080;
+    int         num_frames = 120;
+    const char *output     = "-"; // JSON file, or - for stdout.
+    const char *models[MAX_MODELS];
+    int         num_models = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) sscanf(argv[++i], "%dx%d", &width, &height);
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) num_frames = atoi(argv[++i]);
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output = argv[++i];
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc && num_models < MAX_MODELS) models[num_models++] = argv[++i];
+    }
+    num_frames = MAX(1, num_frames);
+    if (num_models == 0) {
+        num_models = sizeof(_default_models) / sizeof(_default_models[0]);
+        memcpy(models, _default_models, sizeof(_default_models));
+    }
+
+    // Results written to stdout keep it to themselves, and everything printed goes to stderr.
+    FILE *json;
+    if (strcmp(output, "-") == 0) {
+        json = fdopen(dup(fileno(stdout)), "w");
+        dup2(fileno(stderr), fileno(stdout));
+    } else {
+        json = fopen(output, "w");
+    }
+    if (!json) {
+        printf("bench: Couldn't open %s.\n", output);
+        return EXIT_FAILURE;
+    }
+
+    struct Engine *e = Engine_create_headless(width, height);
+    float default_z_far = e->z_far;
+
+    struct FrameRecord *records = malloc(sizeof(struct FrameRecord) * num_frames);
+    float              *ms      = malloc(sizeof(float) * num_frames);
+
+    fprintf(json, "{\n");
+    fprintf(json, "  \"width\": %d,\n  \"height\": %d,\n", width, height);
+    fprintf(json, "  \"threads\": %d,\n  \"kernel\": \"%s\",\n", e->multithreaded ? e->pool->num_threads : 1, Raster_kernel_name(e->raster_kernel));
+    fprintf(json, "  \"depth_format\": \"%s\",\n", Raster_depth_format_name(e->depth_format));
+    fprintf(json, "  \"frames_per_path\": %d,\n", num_frames);
+    fprintf(json, "  \"results\": [");
+
+    int first  = 1;
+    int failed = 0;
+    for (int m = 0; m < num_models; ++m) {
+        // Models that can't be loaded are left out of the results, and the run fails at the end.
+        struct Model *model = Model_from_obj(models[m], 0, 0, 0, 0, 0, 0, 1, 1, 1);
+        if (!model) {
+            printf("bench: Couldn't load %s, skipping it.\n", models[m]);
+            failed = 1;
+            continue;
+        }
+
+        struct Scene *scene = Scene_create();
+        Scene_add(scene, model);
+        Scene_update(scene);
+
+        struct Vector3 min, max;
+        Scene_bounds(scene, &min, &max);
+        struct Vector3 center = Vector3_smul(Vector3_add(min, max), 0.5);
+        float          radius = Vector3_norm(Vector3_sub(max, min)) * 0.5;
+        e->z_far = MAX(default_z_far, radius * 4);
+
+        for (int p = 0; p < NUM_PATHS; ++p) {
+            struct CameraPath *path = _create_path(p, center, radius);
+
+            Engine_render_path(e, scene, path, WARMUP_FRAMES, IMAGE_PPM, NULL, NULL, NULL);
+            Engine_render_path(e, scene, path, num_frames, IMAGE_PPM, NULL, NULL, records);
+
+            double total_ms        = 0;
+            double total_triangles = 0;
+            double total_pixels    = 0;
+            for (int i = 0; i < num_frames; ++i) {
+                ms[i]            = records[i].ms;
+                total_ms        += records[i].ms;
+                total_triangles += records[i].stats.tris_rasterized;
+                total_pixels    += records[i].stats.pixels_passed;
+            }
+            qsort(ms, num_frames, sizeof(float), _compare_floats);
+
+            double seconds = MAX(total_ms / 1000, 1e-9);
+            fprintf(json, "%s\n    {\"model\": ", first ? "" : ",");
+            _write_json_string(json, models[m]);
+            fprintf(json, ", \"path\": \"%s\", ", _path_names[p]);
+            fprintf(json, "\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, ",
+                total_ms / num_frames, _percentile(ms, num_frames, 50), _percentile(ms, num_frames, 95), _percentile(ms, num_frames, 99));
+            fprintf(json, "\"triangles_per_frame\": %.1f, \"triangles_per_s\": %.0f, \"pixels_per_s\": %.0f}",
+                total_triangles / num_frames, total_triangles / seconds, total_pixels / seconds);
+            first = 0;
+
+            CameraPath_destroy(path);
+        }
+
+        Scene_destroy(scene);
+    }
+
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+
+    free(records);
+    free(ms);
+    Engine_destroy(e);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "camera_path.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Keys in an orbit. Enough that the chords between them stay close to the circle.
+#define ORBIT_KEYS 64
+
+struct CameraPath *CameraPath_create() {
+    struct CameraPath *path = malloc(sizeof(struct CameraPath));
+
+    path->num_keys = 0;
+    path->capacity = 16;
+    path->keys     = malloc(sizeof(struct CameraKey) * path->capacity);
+
+    return path;
+}
+
+void CameraPath_destroy(struct CameraPath *path) {
+    free(path->keys);
+    free(path);
+}
+
+void CameraPath_add(struct CameraPath *path, struct Vector3 position, struct Vector3 target) {
+    if (path->num_keys == path->capacity) {
+        path->capacity *= 2;
+        path->keys = realloc(path->keys, sizeof(struct CameraKey) * path->capacity);
+    }
+
+    path->keys[path->num_keys].position = position;
+    path->keys[path->num_keys].target   = target;
+    ++path->num_keys;
+}
+
+struct CameraPath *CameraPath_from_file(const char *file_name) {
+    FILE *file = fopen(file_name, "r");
+    if (!file) {
+        return NULL;
+    }
+
+    struct CameraPath *path = CameraPath_create();
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        float px, py, pz, tx, ty, tz;
+        if (line[0] == '#' || sscanf(line, "%f %f %f %f %f %f", &px, &py, &pz, &tx, &ty, &tz) != 6) {
+            continue;
+        }
+        CameraPath_add(path, Vector3_create_point(px, py, pz), Vector3_create_point(tx, ty, tz));
+    }
+    fclose(file);
+
+    if (path->num_keys == 0) {
+        CameraPath_destroy(path);
+        return NULL;
+    }
+
+    return path;
+}
+
+struct CameraPath *CameraPath_orbit(struct Vector3 center, float distance, float height) {
+    struct CameraPath *path = CameraPath_create();
+
+    // The last key closes the circle.
+    for (int i = 0; i <= ORBIT_KEYS; ++i) {
+        float angle = 2 * M_PI * i / ORBIT_KEYS;
+        struct Vector3 position = Vector3_add(center, Vector3_create_direction(distance * sinf(angle), height, -distance * cosf(angle)));
+        CameraPath_add(path, position, center);
+    }
+
+    return path;
+}
+
+struct CameraKey CameraPath_sample(const struct CameraPath *path, float t) {
+    float f = MAX(0, MIN(1, t)) * (path->num_keys - 1);
+    int   i = MIN((int)f, path->num_keys - 2);
+
+    if (i < 0) {
+        return path->keys[0];
+    }
+
+    const struct CameraKey *a = &path->keys[i];
+    const struct CameraKey *b = &path->keys[i + 1];
+    float s = f - i;
+
+    struct CameraKey key;
+    key.position = Vector3_add(a->position, Vector3_smul(Vector3_sub(b->position, a->position), s));
+    key.target   = Vector3_add(a->target,   Vector3_smul(Vector3_sub(b->target,   a->target),   s));
+    return key;
+}
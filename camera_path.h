@@ -0,0 +1,41 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "vector3.h"
+#include "util.h"
+
+// A camera's position and the point it looks at.
+struct CameraKey {
+    struct Vector3 position;
+    struct Vector3 target;
+};
+
+// Camera keys passed through in order, at an even pace, for rendering without input.
+struct CameraPath {
+    struct CameraKey *keys;
+    int               num_keys;
+    int               capacity;
+};
+
+// We move CameraPath instances with heap pointers.
+
+struct CameraPath *CameraPath_create();
+void               CameraPath_destroy(struct CameraPath *path);
+
+void               CameraPath_add(struct CameraPath *path, struct Vector3 position, struct Vector3 target);
+
+// Reads a path with one key per line, as "px py pz tx ty tz" (position, then target). Blank lines
+// and lines starting with # are skipped. Returns NULL if the file can't be read or has no keys.
+struct CameraPath *CameraPath_from_file(const char *file_name);
+
+// A full circle around center, at the given distance from it and height above it, looking at it.
+struct CameraPath *CameraPath_orbit(struct Vector3 center, float distance, float height);
+
+// The camera at t in [0, 1] along the path, interpolating linearly between keys.
+struct CameraKey   CameraPath_sample(const struct CameraPath *path, float t);
+
+#endif
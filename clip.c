@@ -0,0 +1,121 @@
+#include "clip.h"
+
+// Signed distance (up to scale) of a position from a plane; non-negative is inside.
+static inline float _distance(struct Vector3 pos, int plane, float width, float height) {
+    switch (plane) {
+        case CLIP_NEAR:   return pos.z;
+        case CLIP_LEFT:   return pos.x + CLIP_GUARD_BAND * pos.w;
+        case CLIP_RIGHT:  return (width + CLIP_GUARD_BAND) * pos.w - pos.x;
+        case CLIP_TOP:    return pos.y + CLIP_GUARD_BAND * pos.w;
+        default:          return (height + CLIP_GUARD_BAND) * pos.w - pos.y;
+    }
+}
+
+inline int Clip_outcode(struct Vector3 pos, float width, float height) {
+    int code = 0;
+    for (int plane = CLIP_NEAR; plane <= CLIP_BOTTOM; plane <<= 1) {
+        if (_distance(pos, plane, width, height) < 0) code |= plane;
+    }
+    return code;
+}
+
+static inline struct Vector3 _lerp(struct Vector3 a, struct Vector3 b, float t) {
+    return (struct Vector3){
+        a.x + (b.x - a.x) * t,
+        a.y + (b.y - a.y) * t,
+        a.z + (b.z - a.z) * t,
+        a.w + (b.w - a.w) * t,
+    };
+}
+
+int Clip_polygon(const struct ClipVertex *in, int n, int planes, float width, float height, struct ClipVertex *out) {
+    struct ClipVertex buffers[2][CLIP_MAX_VERTICES];
+    const struct ClipVertex *src = in;
+
+    for (int plane = CLIP_NEAR; plane <= CLIP_BOTTOM && n > 0; plane <<= 1) {
+        if (!(planes & plane)) continue;
+
+        struct ClipVertex *dst = buffers[src == buffers[0]];
+        int m = 0;
+
+        for (int i = 0; i < n; ++i) {
+            const struct ClipVertex *a = &src[i];
+            const struct ClipVertex *b = &src[(i + 1) % n];
+
+            float da = _distance(a->pos, plane, width, height);
+            float db = _distance(b->pos, plane, width, height);
+
+            if (da >= 0) {
+                dst[m++] = *a;
+            }
+
+            // The edge crosses the plane. Attributes are interpolated in clip space, where
+            // they are linear.
+            if ((da >= 0) != (db >= 0)) {
+                float t = da / (da - db);
+                dst[m].pos  = _lerp(a->pos,  b->pos,  t);
+                dst[m].norm = _lerp(a->norm, b->norm, t);
+                dst[m].tip  = _lerp(a->tip,  b->tip,  t);
+
+                // Land exactly on the plane, so rounding can't put the vertex back outside.
+                if (plane == CLIP_NEAR) dst[m].pos.z = 0;
+                ++m;
+            }
+        }
+
+        src = dst;
+        n   = m;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        out[i] = src[i];
+    }
+
+    return n;
+}
+
+static inline struct Vector3 _plane(float a, float b, float c, float d) {
+    float inv_norm = 1 / sqrtf(a * a + b * b + c * c);
+    return (struct Vector3){a * inv_norm, b * inv_norm, c * inv_norm, d * inv_norm};
+}
+
+void Clip_frustum_planes(const struct Matrix4 *m, float width, float height, struct Vector3 planes[6]) {
+    // Each clip space inequality is a combination of the rows of m (Gribb and Hartmann).
+    // Left, x >= 0.
+    planes[0] = _plane(m->x00, m->x01, m->x02, m->x03);
+    // Right, x <= width * w.
+    planes[1] = _plane(width * m->x30 - m->x00, width * m->x31 - m->x01, width * m->x32 - m->x02, width * m->x33 - m->x03);
+    // Top, y >= 0.
+    planes[2] = _plane(m->x10, m->x11, m->x12, m->x13);
+    // Bottom, y <= height * w.
+    planes[3] = _plane(height * m->x30 - m->x10, height * m->x31 - m->x11, height * m->x32 - m->x12, height * m->x33 - m->x13);
+    // Near, z >= 0.
+    planes[4] = _plane(m->x20, m->x21, m->x22, m->x23);
+    // Far, z <= w.
+    planes[5] = _plane(m->x30 - m->x20, m->x31 - m->x21, m->x32 - m->x22, m->x33 - m->x23);
+}
+
+int Clip_test_sphere(const struct Vector3 planes[6], struct Vector3 center, float radius) {
+    int result = CLIP_INSIDE;
+    for (int i = 0; i < 6; ++i) {
+        float d = planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w;
+        if (d < -radius) return CLIP_OUTSIDE;
+        if (d <  radius) result = CLIP_INTERSECT;
+    }
+    return result;
+}
+
+int Clip_test_aabb(const struct Vector3 planes[6], struct Vector3 min, struct Vector3 max) {
+    int result = CLIP_INSIDE;
+    for (int i = 0; i < 6; ++i) {
+        const struct Vector3 *p = &planes[i];
+
+        // The corners farthest along and against the plane normal.
+        float d_max = p->x * (p->x >= 0 ? max.x : min.x) + p->y * (p->y >= 0 ? max.y : min.y) + p->z * (p->z >= 0 ? max.z : min.z) + p->w;
+        float d_min = p->x * (p->x >= 0 ? min.x : max.x) + p->y * (p->y >= 0 ? min.y : max.y) + p->z * (p->z >= 0 ? min.z : max.z) + p->w;
+
+        if (d_max < 0) return CLIP_OUTSIDE;
+        if (d_min < 0) result = CLIP_INTERSECT;
+    }
+    return result;
+}
@@ -0,0 +1,49 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include "vector3.h"
+#include "matrix4.h"
+
+// Guard band, in pixels beyond each edge of the screen. The rasterizer handles triangles reaching
+// off screen by itself, so x and y are only clipped where a triangle reaches past the guard band,
+// which keeps screen coordinates well within the fixed point range (RASTER_MAX_COORD).
+#define CLIP_GUARD_BAND (1 << 20)
+
+// Clip planes, as outcode bits.
+#define CLIP_NEAR   1
+#define CLIP_LEFT   2
+#define CLIP_RIGHT  4
+#define CLIP_TOP    8
+#define CLIP_BOTTOM 16
+
+// Each plane adds at most one vertex to a convex polygon.
+#define CLIP_MAX_VERTICES (3 + 5)
+
+// A vertex in clip space (with the viewport folded in, so x and y are in [0, width * w] and
+// [0, height * w] on screen) and the attributes interpolated along with it.
+struct ClipVertex {
+    struct Vector3 pos;
+    struct Vector3 norm;
+    struct Vector3 tip;
+};
+
+// Planes the position is outside of.
+inline int Clip_outcode(struct Vector3 pos, float width, float height);
+
+// Sutherland-Hodgman clipping of the convex polygon in[0..n) against the given planes, near plane
+// first. Writes at most CLIP_MAX_VERTICES vertices to out and returns how many.
+int        Clip_polygon(const struct ClipVertex *in, int n, int planes, float width, float height, struct ClipVertex *out);
+
+// Results of testing a bounding volume against the frustum.
+#define CLIP_OUTSIDE   0
+#define CLIP_INTERSECT 1
+#define CLIP_INSIDE    2
+
+// Extracts the six frustum planes from a transform to clip space (with the viewport folded in, as
+// above) in the space the transform maps from. Planes are (a, b, c, d) in (x, y, z, w), normalized
+// so (a, b, c) is unit length, with the inside where ax + by + cz + d >= 0.
+void       Clip_frustum_planes(const struct Matrix4 *m, float width, float height, struct Vector3 planes[6]);
+int        Clip_test_sphere(const struct Vector3 planes[6], struct Vector3 center, float radius);
+int        Clip_test_aabb(const struct Vector3 planes[6], struct Vector3 min, struct Vector3 max);
+
+#endif
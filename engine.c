@@ -1,13 +1,18 @@
 #include "engine.h"
+#include "overlay.h"
 
-struct Engine *Engine_create(int window_width, int window_height) {
-    printf("Engine_create: Initializing engine.\n");
+static struct Engine *_create(int window_width, int window_height, int headless) {
+    printf("Engine_create: Initializing engine%s.\n", headless ? " (headless)" : "");
 
-    SDL_Init(SDL_INIT_EVERYTHING);
-    SDL_ShowCursor(0);
+    if (!headless) {
+        SDL_Init(SDL_INIT_EVERYTHING);
+        SDL_ShowCursor(0);
+    }
 
     struct Engine *e = malloc(sizeof(struct Engine));
 
+    e->headless = headless;
+
     e->window_width       = window_width;
     e->window_height      = window_height;
     e->num_window_pixels  = window_width * window_height;
@@ -15,64 +20,144 @@ struct Engine *Engine_create(int window_width, int window_height) {
     e->half_window_height = window_height * 0.5;
     e->aspect_ratio       = (float)window_width / window_height;
 
-    // Window and renderer.
-    e->window = SDL_CreateWindow(
-        "Impromptu", 
-        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
-        e->window_width, e->window_height, 
-        SDL_WINDOW_SHOWN
-    );
-    e->renderer = SDL_CreateRenderer(e->window, -1, SDL_RENDERER_ACCELERATED);
+    // Window and renderer. Headless engines have neither, and draw into staging buffers only.
+    e->window   = NULL;
+    e->renderer = NULL;
+    if (!headless) {
+        e->window = SDL_CreateWindow(
+            "Impromptu", 
+            SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
+            e->window_width, e->window_height, 
+            SDL_WINDOW_SHOWN
+        );
+        e->renderer = SDL_CreateRenderer(e->window, -1, SDL_RENDERER_ACCELERATED);
+    }
     
-    // Frame data.
-    e->frame_texture = SDL_CreateTexture(
-        e->renderer, 
-        SDL_PIXELFORMAT_ABGR8888,    // 4 bytes (each 8 bit) representing alpha, blue, green, and red for each pixel.
-        SDL_TEXTUREACCESS_STREAMING, // Changes frequently, lockable.
-        e->window_width,
-        e->window_height
-    );
+    // Frame data. Staging buffers are only allocated if a texture can't be drawn into.
+    e->frames_in_flight = 2;
+    for (int i = 0; i < ENGINE_MAX_FRAMES_IN_FLIGHT; ++i) {
+        e->targets[i].texture = headless ? NULL : SDL_CreateTexture(
+            e->renderer, 
+            SDL_PIXELFORMAT_ABGR8888,    // 4 bytes (each 8 bit) representing alpha, blue, green, and red for each pixel.
+            SDL_TEXTUREACCESS_STREAMING, // Changes frequently, lockable.
+            e->window_width,
+            e->window_height
+        );
+        e->targets[i].staging = NULL;
+        e->targets[i].locked  = 0;
+        e->targets[i].direct  = 0;
+    }
 
     // Initialize frame buffer (comprised of a color and depth buffer in this case).
     e->color_buffer_size = sizeof(unsigned char) * window_width * window_height * 4;
-    e->depth_buffer_size = sizeof(float) * window_width * window_height;
+    e->vis_buffer_size   = sizeof(uint32_t) * window_width * window_height;
 
-    e->color_buffer = malloc(e->color_buffer_size);
-    e->depth_buffer = malloc(e->depth_buffer_size);
+    e->color_buffer = NULL; // Set to a frame's target as it's drawn.
+    e->color_pitch  = window_width * 4;
+    e->vis_buffer   = malloc(e->vis_buffer_size);
 
-    memset(e->color_buffer, 0, e->color_buffer_size);
-    // memset float arary.
     for (int i = 0; i < e->num_window_pixels; ++i) {
-        e->depth_buffer[i] = -1.0;
+        e->vis_buffer[i] = RASTER_VIS_NONE;
     }
 
+    // Depth is cleared per tile as it's drawn (see Raster_tile).
+    e->depth_buffer = NULL;
+    Raster_set_depth_format(e, RASTER_DEPTH_FLOAT);
+
+    // Tiles and per-frame triangle storage.
+    Raster_create_tiles(e);
+    e->raster_tris_capacity = 1024;
+    e->num_raster_tris      = 0;
+    e->raster_tris          = malloc(sizeof(struct RasterTri) * e->raster_tris_capacity);
+
+    // Scratch space for the vertices of clipped triangles, reused every frame.
+    e->clip_vertices_capacity = 64;
+    e->num_clip_vertices      = 0;
+    e->clip_vertices          = malloc(sizeof(struct ClipVertex) * e->clip_vertices_capacity);
+
+    // Post-transform vertex buffers grow to fit the model.
+    e->post_pos      = NULL;
+    e->post_norm     = NULL;
+    e->post_tip      = NULL;
+    e->post_stamp    = NULL;
+    e->post_capacity = 0;
+    e->post_stamp_value = 0;
+
+    e->visible_meshlets          = NULL;
+    e->visible_meshlet_clip      = NULL;
+    e->visible_meshlets_capacity = 0;
+
+    // One worker per logical CPU (the calling thread counts as one).
+    e->pool = ThreadPool_create(SDL_GetCPUCount());
+    printf("Engine_create: Rasterizing %d tiles on %d threads.\n", e->num_tiles, e->pool->num_threads);
+
     // Controls.
     e->move_speed = 0.005;
     e->look_speed = 0.0001;
 
+    e->z_near = 0.1;
+    e->z_far  = 10;
+
+    // Load options.
+    e->optimize_meshes = 0;
+
     // Render options.
     e->wireframe           = 0;
     e->backface_culling    = 0;
     e->show_vertex_normals = 0;
-    
+    e->multithreaded       = 1;
+    e->raster_kernel       = Raster_best_kernel();
+    e->hiz                 = 1;
+    e->deferred            = 0;
+    e->front_to_back       = 1;
+
+    e->show_stats          = 0;
+
+    // Statistics.
+    memset(&e->stats, 0, sizeof(struct EngineStats));
+    printf("Engine_create: Using the %s raster kernel.\n", Raster_kernel_name(e->raster_kernel));
+
     return e;
 }
 
+struct Engine *Engine_create(int window_width, int window_height) {
+    return _create(window_width, window_height, 0);
+}
+
+struct Engine *Engine_create_headless(int width, int height) {
+    return _create(width, height, 1);
+}
+
 void Engine_destroy(struct Engine *e) {
     printf("Engine_destroy: Destroying engine.\n");
 
-    SDL_DestroyTexture(e->frame_texture);
-    SDL_DestroyRenderer(e->renderer);
-    SDL_DestroyWindow(e->window);
-    SDL_Quit();
+    for (int i = 0; i < ENGINE_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (e->targets[i].texture) SDL_DestroyTexture(e->targets[i].texture);
+        free(e->targets[i].staging);
+    }
+    if (!e->headless) {
+        SDL_DestroyRenderer(e->renderer);
+        SDL_DestroyWindow(e->window);
+        SDL_Quit();
+    }
 
-    free(e->color_buffer);
+    ThreadPool_destroy(e->pool);
+    Raster_destroy_tiles(e);
+    free(e->raster_tris);
+    free(e->clip_vertices);
+    free(e->post_pos);
+    free(e->post_norm);
+    free(e->post_tip);
+    free(e->post_stamp);
+    free(e->visible_meshlets);
+    free(e->visible_meshlet_clip);
     free(e->depth_buffer);
+    free(e->vis_buffer);
     free(e);
 }
 
 inline void Engine_set_pixel(struct Engine *e, int x, int y, int r, int g, int b) {
-    int offset = (e->window_width * y * 4) + x * 4;
+    int offset = (e->color_pitch * y) + x * 4;
     e->color_buffer[offset + 0] = r;
     e->color_buffer[offset + 1] = g;
     e->color_buffer[offset + 2] = b;
@@ -80,11 +165,21 @@ inline void Engine_set_pixel(struct Engine *e, int x, int y, int r, int g, int b
 }
 
 inline void Engine_set_depth(struct Engine *e, int x, int y, float depth) {
-    e->depth_buffer[(e->window_width * y) + x] = depth;
+    int i = (e->window_width * y) + x;
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: ((uint16_t *)e->depth_buffer)[i] = depth; break;
+        case RASTER_DEPTH_UNORM24: ((uint32_t *)e->depth_buffer)[i] = depth; break;
+        default:                   ((float *)e->depth_buffer)[i]    = depth; break;
+    }
 }
 
 inline float Engine_get_depth(struct Engine *e, int x, int y) {
-    return e->depth_buffer[(e->window_width * y) + x];
+    int i = (e->window_width * y) + x;
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: return ((uint16_t *)e->depth_buffer)[i];
+        case RASTER_DEPTH_UNORM24: return ((uint32_t *)e->depth_buffer)[i];
+        default:                   return ((float *)e->depth_buffer)[i];
+    }
 }
 
 inline void Engine_bresenham(struct Engine *e, int x1, int y1, int x2, int y2, int r, int g, int b) {
@@ -146,22 +241,626 @@ inline void Engine_raster_tri_wireframe(struct Engine *e, struct Vector3 v1, str
     Engine_bresenham(e, v3.x, v3.y, v1.x, v1.y, r, g, b);
 }
 
-inline float _edge(float x1, float y1, float x2, float y2, float x3, float y3) {
-    return (x3 - x1) * (y2 - y1) - (y3 - y1) * (x2 - x1);
+static void _raster_tile_job(void *ctx, int job, int thread) {
+    struct Engine *e = ctx;
+    (void)thread;
+
+    TRACE_BEGIN(tile);
+    Raster_tile(e, &e->tiles[job]);
+    TRACE_END(tile, "tile", thread);
+}
+
+// Points the colour buffer at a frame's target: straight into its texture when the texture's rows
+// fit ours, which spares copying the frame into it, or else into its staging buffer.
+static void _begin_frame(struct Engine *e, struct FrameTarget *ft) {
+    ft->locked = ft->texture && SDL_LockTexture(ft->texture, NULL, &ft->pixels, &ft->pitch) == 0;
+    ft->direct = ft->locked && ft->pitch >= e->window_width * 4;
+    if (!ft->direct && !ft->staging) {
+        ft->staging = calloc(e->color_buffer_size, 1);
+    }
+
+    // The texture's old contents aren't kept while it's locked, and the staging buffer was drawn
+    // some frames ago, so tiles can't count on being clear from the last frame unless it was drawn
+    // into the same memory.
+    unsigned char *color_buffer = ft->direct ? ft->pixels : ft->staging;
+    if (ft->direct || color_buffer != e->color_buffer) {
+        for (int i = 0; i < e->num_tiles; ++i) {
+            e->tiles[i].clear = 0;
+        }
+    }
+    e->color_buffer = color_buffer;
+    e->color_pitch  = ft->direct ? ft->pitch : e->window_width * 4;
+}
+
+// Puts a drawn frame on screen.
+static void _present_frame(struct Engine *e, struct FrameTarget *ft) {
+    // Copy pixels to texture, row by row as the pitch may differ, unless they're already there.
+    TRACE_BEGIN(upload);
+    PERF_BEGIN(upload);
+    if (ft->locked) {
+        if (!ft->direct) {
+            int row_size = e->window_width * 4;
+            for (int y = 0; y < e->window_height; ++y) {
+                memcpy((unsigned char *)ft->pixels + y * ft->pitch, &ft->staging[row_size * y], MIN(ft->pitch, row_size));
+            }
+        }
+        SDL_UnlockTexture(ft->texture);
+        ft->locked = 0;
+    } else {
+        SDL_UpdateTexture(ft->texture, NULL, ft->staging, e->window_width * 4);
+    }
+    PERF_END(upload, PERF_STAGE_UPLOAD, (uint64_t)e->window_width * e->window_height);
+    TRACE_END(upload, "upload", 0);
+
+    TRACE_BEGIN(present);
+    PERF_BEGIN(present);
+
+    // Copy texture to renderer.
+    SDL_RenderCopy(e->renderer, ft->texture, NULL, NULL);
+    
+    // Present renderer.
+    SDL_RenderPresent(e->renderer);
+
+    PERF_END(present, PERF_STAGE_PRESENT, 1);
+    TRACE_END(present, "present", 0);
+}
+
+// Transforms a point or direction (Matrix4_vmul, spelled out so the vertex stage's loop can inline it).
+static inline struct Vector3 _transform(const struct Matrix4 *a, struct Vector3 v) {
+    return (struct Vector3) {
+        v.x * a->x00 + v.y * a->x01 + v.z * a->x02 + v.w * a->x03,
+        v.x * a->x10 + v.y * a->x11 + v.z * a->x12 + v.w * a->x13,
+        v.x * a->x20 + v.y * a->x21 + v.z * a->x22 + v.w * a->x23,
+        v.x * a->x30 + v.y * a->x31 + v.z * a->x32 + v.w * a->x33,
+    };
+}
+
+// Transforms vertex i of the model into the post-transform buffers. colour, if not NULL, tints
+// the shading.
+static inline void _vertex(struct Engine *e, const struct Model *model, const struct Matrix4 *model_to_world, const struct Matrix4 *world_to_model, const struct Matrix4 *mvp_viewport, const struct Vector3 *colour, int i) {
+    const struct Vertex *vertex = &model->vertices[i];
+    struct Vector3 half = {0.5, 0.5, 0.5, 0};
+
+    e->post_pos[i] = _transform(mvp_viewport, vertex->pos);
+
+    // Transform unit normals (components in range [-1, 1]) to be suitable for colouring (components in range [0, 1]).
+    struct Vector3 n = Vector3_normalize(_transform(model_to_world, vertex->norm));
+    e->post_norm[i] = Vector3_add(Vector3_smul(n, 0.5), half);
+    if (colour) {
+        e->post_norm[i].x *= colour->x;
+        e->post_norm[i].y *= colour->y;
+        e->post_norm[i].z *= colour->z;
+    }
+
+    // For rendering normals. These are locations of vertices plus their normals, as 0.02 unit long
+    // vectors in world space. The offset is taken back to model space, so scaled models get normals
+    // of the same length.
+    if (e->show_vertex_normals) {
+        struct Vector3 tip = Vector3_add(vertex->pos, _transform(world_to_model, Vector3_smul(n, 0.02)));
+        e->post_tip[i] = _transform(mvp_viewport, tip);
+    }
+}
+
+// Vertex stage. Transforms each unique vertex of the visible meshlets once into the post-transform
+// buffers, which triangle assembly then reads through the index buffer. mvp_viewport is
+// viewport * projection * view * model, so positions come out in clip space with the viewport
+// folded in (dividing by w yields screen coordinates).
+static void _vertex_stage(struct Engine *e, const struct Model *model, const struct ModelLod *lod, const struct Matrix4 *model_to_world, const struct Matrix4 *world_to_model, const struct Matrix4 *mvp_viewport, const struct Vector3 *colour, int num_visible) {
+    int num_vertices = model->num_vertices;
+
+    if (e->post_capacity < num_vertices) {
+        e->post_capacity = num_vertices;
+        e->post_pos   = realloc(e->post_pos,   sizeof(struct Vector3) * e->post_capacity);
+        e->post_norm  = realloc(e->post_norm,  sizeof(struct Vector3) * e->post_capacity);
+        e->post_tip   = realloc(e->post_tip,   sizeof(struct Vector3) * e->post_capacity);
+        e->post_stamp = realloc(e->post_stamp, sizeof(uint32_t) * e->post_capacity);
+        memset(e->post_stamp, 0, sizeof(uint32_t) * e->post_capacity);
+        e->post_stamp_value = 0;
+    }
+
+    // Nothing culled at full detail: stream through the whole vertex buffer. Coarser levels use
+    // only some of the vertices.
+    if (lod == &model->lods[0] && num_visible == lod->num_meshlets) {
+        for (int i = 0; i < num_vertices; ++i) {
+            _vertex(e, model, model_to_world, world_to_model, mvp_viewport, colour, i);
+        }
+        return;
+    }
+
+    // Otherwise, go meshlet by meshlet, skipping vertices shared with meshlets already done.
+    if (++e->post_stamp_value == 0) {
+        memset(e->post_stamp, 0, sizeof(uint32_t) * e->post_capacity);
+        e->post_stamp_value = 1;
+    }
+
+    for (int j = 0; j < num_visible; ++j) {
+        const struct Meshlet *ml = &lod->meshlets[e->visible_meshlets[j]];
+        const uint32_t *mv = &lod->meshlet_vertices[ml->first_vertex];
+
+        for (int k = 0; k < ml->num_vertices; ++k) {
+            uint32_t i = mv[k];
+            if (e->post_stamp[i] != e->post_stamp_value) {
+                e->post_stamp[i] = e->post_stamp_value;
+                _vertex(e, model, model_to_world, world_to_model, mvp_viewport, colour, i);
+            }
+        }
+    }
+}
+
+// Perspective divide, then hands the triangle to the rasterizer. Drawing is deferred until every
+// triangle of the frame has been binned into the screen tiles it overlaps.
+static void _emit_tri(struct Engine *e, const struct ClipVertex *c0, const struct ClipVertex *c1, const struct ClipVertex *c2) {
+    if (e->num_raster_tris == e->raster_tris_capacity) {
+        e->raster_tris_capacity *= 2;
+        e->raster_tris = realloc(e->raster_tris, sizeof(struct RasterTri) * e->raster_tris_capacity);
+    }
+
+    // --- PERSPECTIVE DIVIDE ---
+
+    // This lands directly in screen space.
+    struct RasterTri *rt = &e->raster_tris[e->num_raster_tris++];
+    rt->v0 = Vector3_smul(c0->pos, 1 / c0->pos.w);
+    rt->v1 = Vector3_smul(c1->pos, 1 / c1->pos.w);
+    rt->v2 = Vector3_smul(c2->pos, 1 / c2->pos.w);
+
+    // Depth in the depth buffer's format. Reversed Z is near / w, which is what a reversed
+    // projection with an infinite far plane yields, and is stored negated so nearer stays smaller.
+    if (e->depth_format == RASTER_DEPTH_REVERSED) {
+        rt->v0.z = -e->z_near / c0->pos.w;
+        rt->v1.z = -e->z_near / c1->pos.w;
+        rt->v2.z = -e->z_near / c2->pos.w;
+    } else {
+        rt->v0.z *= e->depth_scale;
+        rt->v1.z *= e->depth_scale;
+        rt->v2.z *= e->depth_scale;
+    }
+
+    rt->n0 = c0->norm;
+    rt->n1 = c1->norm;
+    rt->n2 = c2->norm;
+
+    if (e->show_vertex_normals) {
+        rt->vn0 = Vector3_smul(c0->tip, 1 / c0->tip.w);
+        rt->vn1 = Vector3_smul(c1->tip, 1 / c1->tip.w);
+        rt->vn2 = Vector3_smul(c2->tip, 1 / c2->tip.w);
+    }
+
+    // --- SCREEN SPACE ----
+
+    // Snap to the sub-pixel grid and set up the edge functions once per triangle.
+    Raster_setup_tri(e, rt);
+}
+
+// Frustum planes of a transform to clip space (see Clip_frustum_planes). Reversed Z has no far
+// plane, so it's replaced by one everything is inside of.
+static void _frustum_planes(const struct Engine *e, const struct Matrix4 *m, struct Vector3 planes[6]) {
+    Clip_frustum_planes(m, e->window_width, e->window_height, planes);
+    if (e->depth_format == RASTER_DEPTH_REVERSED) {
+        planes[5] = (struct Vector3){0, 0, 0, 1};
+    }
+}
+
+// Pixels a unit of the model's space spans on screen, at most (at the near side of its bounding
+// sphere). pixel_scale is the same at unit distance from the camera. Infinite with the camera
+// inside the sphere.
+static float _pixels_per_unit(const struct Model *model, const struct Matrix4 *model_to_world, float pixel_scale, struct Vector3 camera_pos) {
+    float scale = Matrix4_max_scale(model_to_world);
+
+    struct Vector3 center = Matrix4_vmul(model_to_world, model->sphere_center);
+    float distance = Vector3_norm(Vector3_sub(center, camera_pos)) - scale * model->sphere_radius;
+    if (distance <= 0) {
+        return INFINITY;
+    }
+
+    return pixel_scale * scale / distance;
+}
+
+// Runs the geometry stages for a model's level of detail, appending its visible triangles to the
+// frame's RasterTris. The transform is passed separately so instances can share the model's mesh,
+// as can a colour to tint it with (or NULL).
+static void _draw_model(struct Engine *e, const struct Model *model, const struct Matrix4 *model_to_world, int level, const struct Vector3 *colour, const struct Matrix4 *view_projection, const struct Matrix4 *viewport, struct Vector3 camera_pos) {
+    const struct ModelLod *lod   = &model->lods[level];
+    struct EngineStats    *stats = &e->stats;
+
+    stats->tris_submitted += lod->num_tris;
+
+    struct Matrix4 model_inv;
+    struct Matrix4 model_inv_transpose;
+    Matrix4_inverse(model_to_world, &model_inv);
+    Matrix4_transpose(&model_inv, &model_inv_transpose);
+
+    // The following is something like a rendering pipeline. Specifically, the one specified in OpenGL.
+
+    // Concatenate the whole transform (matrices apply right to left).
+    struct Matrix4 model_view_projection;
+    struct Matrix4 mvp_viewport;
+    Matrix4_mul(view_projection, model_to_world, &model_view_projection);
+    Matrix4_mul(viewport, &model_view_projection, &mvp_viewport);
+
+    // -- CULL THE MODEL --
+    //
+    // Test the model's bounds against the frustum (in model space, where the planes come straight
+    // out of the combined matrix) before transforming any vertex. Models entirely inside skip the
+    // per-triangle frustum tests and clipping.
+    struct Vector3 frustum[6];
+    _frustum_planes(e, &mvp_viewport, frustum);
+
+    int visibility = Clip_test_sphere(frustum, model->sphere_center, model->sphere_radius);
+    if (visibility == CLIP_INTERSECT) {
+        visibility = Clip_test_aabb(frustum, model->aabb_min, model->aabb_max);
+    }
+    if (visibility == CLIP_OUTSIDE) {
+        stats->tris_model_culled += lod->num_tris;
+        return;
+    }
+
+    // Back-face culling happens in model space, so it needs the camera there. Mirroring
+    // model matrices flip the winding.
+    struct Vector3 camera_pos_model = Matrix4_vmul(&model_inv, camera_pos);
+    float winding = Matrix4_det(model_to_world) < 0 ? -1 : 1;
+
+    float screen_w = e->window_width;
+    float screen_h = e->window_height;
+
+    // -- CULL MESHLETS --
+    //
+    // Same again for each meshlet's bounding sphere, then its normal cone: if the camera is in
+    // the region where every triangle of the meshlet faces away, none of them would survive
+    // back-face culling. The cones are built for the model's own winding, so they aren't used
+    // for mirrored models.
+    if (e->visible_meshlets_capacity < lod->num_meshlets) {
+        e->visible_meshlets_capacity = lod->num_meshlets;
+        e->visible_meshlets     = realloc(e->visible_meshlets,     sizeof(int) * e->visible_meshlets_capacity);
+        e->visible_meshlet_clip = realloc(e->visible_meshlet_clip, sizeof(unsigned char) * e->visible_meshlets_capacity);
+    }
+
+    int cone_culling = e->backface_culling && winding > 0;
+    int num_visible  = 0;
+
+    for (int j = 0; j < lod->num_meshlets; ++j) {
+        const struct Meshlet *ml = &lod->meshlets[j];
+
+        if (cone_culling) {
+            struct Vector3 view = Vector3_sub(ml->cone_apex, camera_pos_model);
+            float view_norm = Vector3_norm(view);
+            if (Vector3_dot(view, ml->cone_axis) > (ml->cone_cutoff + MESHLET_CONE_EPSILON) * view_norm) {
+                stats->tris_meshlet_culled += ml->num_tris;
+                continue;
+            }
+        }
+
+        int meshlet_visibility = visibility;
+        if (meshlet_visibility != CLIP_INSIDE) {
+            meshlet_visibility = Clip_test_sphere(frustum, ml->center, ml->radius);
+            if (meshlet_visibility == CLIP_OUTSIDE) {
+                stats->tris_meshlet_culled += ml->num_tris;
+                continue;
+            }
+        }
+
+        e->visible_meshlets[num_visible]     = j;
+        e->visible_meshlet_clip[num_visible] = meshlet_visibility;
+        ++num_visible;
+    }
+
+    TRACE_BEGIN(vertex);
+    _vertex_stage(e, model, lod, model_to_world, &model_inv, &mvp_viewport, colour, num_visible);
+    TRACE_END(vertex, "vertex", 0);
+
+    for (int j = 0; j < num_visible; ++j) {
+        const struct Meshlet *ml = &lod->meshlets[e->visible_meshlets[j]];
+        int meshlet_visibility   = e->visible_meshlet_clip[j];
+
+        for (int i = ml->first_tri; i < ml->first_tri + ml->num_tris; ++i) {
+            // Triangle assembly.
+            uint32_t i0 = lod->indices[3 * i + 0];
+            uint32_t i1 = lod->indices[3 * i + 1];
+            uint32_t i2 = lod->indices[3 * i + 2];
+
+            struct Vector3 v0 = e->post_pos[i0];
+            struct Vector3 v1 = e->post_pos[i1];
+            struct Vector3 v2 = e->post_pos[i2];
+
+            if (e->backface_culling) {
+                struct Vector3 p0 = model->vertices[i0].pos;
+                struct Vector3 p1 = model->vertices[i1].pos;
+                struct Vector3 p2 = model->vertices[i2].pos;
+
+                struct Vector3 plane_normal = Vector3_cross(Vector3_sub(p1, p0), Vector3_sub(p2, p0));
+                struct Vector3 cam_ray = Vector3_sub(p0, camera_pos_model);
+
+                // If face isn't facing camera, don't proceed (back-face culling).
+                if (winding * Vector3_dot(plane_normal, cam_ray) >= 0) {
+                    stats->tris_backface_culled += 1;
+                    continue;
+                }
+            }
+
+            struct ClipVertex c0 = {v0, e->post_norm[i0], e->post_tip[i0]};
+            struct ClipVertex c1 = {v1, e->post_norm[i1], e->post_tip[i1]};
+            struct ClipVertex c2 = {v2, e->post_norm[i2], e->post_tip[i2]};
+
+            if (meshlet_visibility == CLIP_INSIDE) {
+                _emit_tri(e, &c0, &c1, &c2);
+                continue;
+            }
+
+            // -- CULL IN CLIP SPACE --
+            // 
+            // If the entire triangle is outside the view frustrum, don't even bother with
+            // perspective divide and rasterization. With the viewport folded into the transform,
+            // -w <= x <= w becomes 0 <= x <= width * w (and likewise for y).
+
+            // Entire triangle is out left.
+            if (v0.x < 0 && 
+                v1.x < 0 && 
+                v2.x < 0) {
+                stats->tris_frustum_culled[ENGINE_CULL_LEFT] += 1;
+                continue;
+            }
+
+            // Entire triangle is out right.
+            if (v0.x > screen_w * v0.w && 
+                v1.x > screen_w * v1.w && 
+                v2.x > screen_w * v2.w) {
+                stats->tris_frustum_culled[ENGINE_CULL_RIGHT] += 1;
+                continue;
+            }
+
+            // Entire triangle is out top.
+            if (v0.y < 0 && 
+                v1.y < 0 && 
+                v2.y < 0) {
+                stats->tris_frustum_culled[ENGINE_CULL_TOP] += 1;
+                continue;
+            }
+
+            // Entire triangle is out bottom.
+            if (v0.y > screen_h * v0.w && 
+                v1.y > screen_h * v1.w && 
+                v2.y > screen_h * v2.w) {
+                stats->tris_frustum_culled[ENGINE_CULL_BOTTOM] += 1;
+                continue;
+            }
+
+            // Entire triangle is out near. The clipper would leave nothing of it, but it's cheaper
+            // to find out here.
+            if (v0.z < 0 && 
+                v1.z < 0 && 
+                v2.z < 0) {
+                stats->tris_frustum_culled[ENGINE_CULL_NEAR] += 1;
+                continue;
+            }
+
+            // Entire triangle is out far (there's no far plane with reversed Z).
+            if (v0.z > v0.w && 
+                v1.z > v1.w && 
+                v2.z > v2.w && e->depth_format != RASTER_DEPTH_REVERSED) {
+                stats->tris_frustum_culled[ENGINE_CULL_FAR] += 1;
+                continue;
+            }
+
+            // -- CLIP --
+            //
+            // Almost every triangle is in front of the near plane and within the guard band, and
+            // goes straight to the rasterizer. The rest are clipped into the frame's scratch
+            // buffer and fanned back into triangles.
+            int planes = Clip_outcode(v0, screen_w, screen_h) | Clip_outcode(v1, screen_w, screen_h) | Clip_outcode(v2, screen_w, screen_h);
+
+            if (!planes) {
+                _emit_tri(e, &c0, &c1, &c2);
+                continue;
+            }
+
+            if (e->num_clip_vertices + CLIP_MAX_VERTICES > e->clip_vertices_capacity) {
+                e->clip_vertices_capacity *= 2;
+                e->clip_vertices = realloc(e->clip_vertices, sizeof(struct ClipVertex) * e->clip_vertices_capacity);
+            }
+
+            struct ClipVertex  tri[3]  = {c0, c1, c2};
+            struct ClipVertex *polygon = &e->clip_vertices[e->num_clip_vertices];
+            int n = Clip_polygon(tri, 3, planes, screen_w, screen_h, polygon);
+            e->num_clip_vertices += n;
+
+            stats->tris_clipped += 1;
+            if (n < 3) {
+                stats->tris_clipped_away += 1;
+            }
+
+            for (int j = 1; j + 1 < n; ++j) {
+                _emit_tri(e, &polygon[0], &polygon[j], &polygon[j + 1]);
+            }
+        }
+    }
+}
+
+// Reports a model's size, and reorders its triangles if asked to, the first time the model is drawn.
+static void _load_model(struct Engine *e, struct Model *model) {
+    if (model->loaded) {
+        return;
+    }
+    model->loaded = 1;
+
+    printf("Triangle count = %d, vertex count = %d\n", model->lods[0].num_tris, model->num_vertices);
+    for (int l = 1; l < model->num_lods; ++l) {
+        printf("LOD %d: triangle count = %d, error = %g\n", l, model->lods[l].num_tris, model->lods[l].error);
+    }
+
+    if (e->optimize_meshes) {
+        float acmr = Model_acmr(model, 32);
+        Model_optimize_vertex_cache(model);
+        float acmr_cache = Model_acmr(model, 32);
+        Model_optimize_overdraw(model);
+        printf("Engine_run: Reordered triangles, ACMR %.3f -> %.3f (vertex cache) -> %.3f (overdraw).\n", acmr, acmr_cache, Model_acmr(model, 32));
+    }
 }
 
-void Engine_run(struct Engine *e) {
+// What drawing a scene needs besides the camera, set up once for every frame (see _draw_scene).
+struct _SceneDraw {
+    struct Scene  *scene;
+    struct Matrix4 projection;
+    struct Matrix4 viewport;
+    float          pixel_scale; // Pixels per unit at unit distance in front of the camera, for LOD selection.
+
+    // Models and instances in view, found each frame.
+    int *visible_models;
+    int *visible_instances;
+};
+
+static void _begin_scene(struct Engine *e, struct Scene *scene, struct _SceneDraw *sd) {
+    for (int i = 0; i < scene->num_models; ++i) {
+        _load_model(e, scene->models[i]);
+    }
+    for (int i = 0; i < scene->num_instances; ++i) {
+        _load_model(e, scene->instances[i]->model);
+    }
+
+    sd->scene          = scene;
+    sd->visible_models = malloc(sizeof(int) * MAX(scene->num_models, 1));
+
+    int max_instances = 1;
+    for (int i = 0; i < scene->num_instances; ++i) {
+        max_instances = MAX(max_instances, scene->instances[i]->count);
+    }
+    sd->visible_instances = malloc(sizeof(int) * max_instances);
+
+    Matrix4_perspective(90, e->aspect_ratio, e->z_near, e->z_far, &sd->projection);
+    Matrix4_viewport(e->window_width, e->window_height, &sd->viewport);
+    sd->pixel_scale = 0.5f * MAX(sd->projection.x00 * e->window_width, sd->projection.x11 * e->window_height);
+}
+
+static void _end_scene(struct _SceneDraw *sd) {
+    free(sd->visible_models);
+    free(sd->visible_instances);
+}
+
+// Transforms, culls and clips the scene's triangles as seen through the view, and bins them into
+// tiles for rasterization.
+static void _draw_scene(struct Engine *e, struct _SceneDraw *sd, const struct Matrix4 *view, struct Vector3 camera_pos) {
+    TRACE_BEGIN(geometry);
+    PERF_BEGIN(geometry);
+
+    // Frame buffers are cleared lazily, tile by tile, in Raster_tile.
+    e->num_raster_tris   = 0;
+    e->num_clip_vertices = 0;
+    memset(&e->stats, 0, sizeof(struct EngineStats));
+
+    // Concatenate the camera transforms once per frame (matrices apply right to left).
+    struct Matrix4 view_projection;
+    Matrix4_mul(&sd->projection, view, &view_projection);
+
+    // Only models whose world space bounds intersect the frustum are drawn. The BVH is refit
+    // first in case any of them moved.
+    struct Matrix4 vp_viewport;
+    struct Vector3 frustum[6];
+    Matrix4_mul(&sd->viewport, &view_projection, &vp_viewport);
+    _frustum_planes(e, &vp_viewport, frustum);
+
+    TRACE_BEGIN(cull);
+    Scene_update(sd->scene);
+    int num_visible_models = Scene_frustum_query(sd->scene, frustum, sd->visible_models);
+    TRACE_END(cull, "cull", 0);
+
+    for (int i = 0; i < num_visible_models; ++i) {
+        struct Model *model = sd->scene->models[sd->visible_models[i]];
+        model->lod = Model_select_lod(model, model->lod, _pixels_per_unit(model, &model->model_to_world, sd->pixel_scale, camera_pos));
+        _draw_model(e, model, &model->model_to_world, model->lod, NULL, &view_projection, &sd->viewport, camera_pos);
+    }
+
+    // Instances are culled one by one, and each keeps its own level of detail.
+    for (int i = 0; i < sd->scene->num_instances; ++i) {
+        struct Instances *inst = sd->scene->instances[i];
+
+        TRACE_BEGIN(cull);
+        int num_visible_instances = Instances_frustum_query(inst, frustum, sd->visible_instances);
+        TRACE_END(cull, "cull", 0);
+
+        for (int j = 0; j < num_visible_instances; ++j) {
+            int k = sd->visible_instances[j];
+            const struct Matrix4 *transform = &inst->transforms[k];
+            inst->lods[k] = Model_select_lod(inst->model, inst->lods[k], _pixels_per_unit(inst->model, transform, sd->pixel_scale, camera_pos));
+            _draw_model(e, inst->model, transform, inst->lods[k], inst->colours ? &inst->colours[k] : NULL, &view_projection, &sd->viewport, camera_pos);
+        }
+    }
+
+    // --- RASTERIZE TRIANGLES ---
+
+    // Bin in a single global order (submission order, or roughly front to back so that the
+    // depth test and Hi-Z reject as much as possible) so every tile draws its triangles in the
+    // same order a single-threaded rasterizer would.
+    TRACE_BEGIN(bin);
+    for (int i = 0; i < e->num_tiles; ++i) {
+        e->tiles[i].num_tris = 0;
+    }
+    if (e->front_to_back) {
+        Raster_sort_tris(e);
+        for (int i = 0; i < e->num_raster_tris; ++i) {
+            Raster_bin_tri(e, e->raster_order[i]);
+        }
+    } else {
+        for (int i = 0; i < e->num_raster_tris; ++i) {
+            Raster_bin_tri(e, i);
+        }
+    }
+    TRACE_END(bin, "bin", 0);
+
+    PERF_END(geometry, PERF_STAGE_GEOMETRY, e->stats.tris_submitted);
+    TRACE_END(geometry, "geometry", 0);
+}
+
+// Sums up the tiles' statistics of the frame just rasterized. The geometry stages count theirs
+// as they go (see _draw_scene).
+static void _gather_stats(struct Engine *e) {
+    struct EngineStats *stats = &e->stats;
+
+    stats->tris_rasterized     = e->num_raster_tris;
+    stats->tris_hiz_rejected   = 0;
+    stats->pixels_tested       = 0;
+    stats->pixels_passed       = 0;
+    stats->pixels_shaded       = 0;
+    stats->pixels_covered      = 0;
+    stats->hiz_rejected_blocks = 0;
+    for (int i = 0; i < e->num_tiles; ++i) {
+        const struct Tile *t = &e->tiles[i];
+        stats->tris_hiz_rejected   += t->hiz_rejected_tris;
+        stats->pixels_tested       += t->pixels_tested;
+        stats->pixels_passed       += t->pixels_written;
+        stats->pixels_shaded       += t->pixels_shaded;
+        stats->pixels_covered      += t->pixels_covered;
+        stats->hiz_rejected_blocks += t->hiz_rejected_blocks;
+    }
+}
+
+int Engine_run(struct Engine *e) {
     printf("Engine_run: running engine.\n");
 
     // Models.
-    struct Model *model = Model_from_obj(
+    struct Model *casa = Model_from_obj(
         "models/casa.obj", 
         0, 0, 1, 
         0, 0, 0, 
         1, 1, 1
     );
-    //struct Model *model = Model_unit_cube();
-    printf("Triangle count = %d\n", model->num_tris);
+    if (!casa) {
+        printf("Engine_run: Couldn't load models/casa.obj.\n");
+        return -1;
+    }
+
+    struct Scene *scene = Scene_create();
+    Scene_add(scene, casa);
+    //Scene_add(scene, Model_unit_cube());
+
+    // Many copies of a mesh share it as instances:
+    // struct Instances *props = Instances_create(Model_from_obj("models/suzanne.obj", 0, 0, 0, 0, 0, 0, 1, 1, 1));
+    // for (int i = 0; i < 500; ++i) {
+    //     struct Matrix4 transform;
+    //     Matrix4_translate(i % 25 - 12, 2, i / 25 + 2, &transform);
+    //     Instances_add(props, &transform, NULL);
+    // }
+    // Scene_add_instances(scene, props);
+
+    struct _SceneDraw sd;
+    _begin_scene(e, scene, &sd);
 
     // Lights.
     // struct LightSource point_light;
@@ -170,9 +869,6 @@ void Engine_run(struct Engine *e) {
     // float tmp_light_rotation_angle = 0;
 
     // Transformations.
-    struct Matrix4 projection;
-    Matrix4_perspective(90, e->aspect_ratio, 0.1, 10, &projection);
-
     struct Matrix4 view;
     struct Vector3 camera_pos = Vector3_create_point(0, 0, 0);
     Matrix4_look_at(
@@ -182,14 +878,11 @@ void Engine_run(struct Engine *e) {
         &view
     );
 
-    struct Matrix4 viewport;
-    Matrix4_viewport(e->window_width, e->window_height, &viewport);
-
     // Timing.
     Uint64 frame_start = 0;
     Uint64 frame_end   = SDL_GetPerformanceCounter();
     float dt = 0;
-    char fps_string[20];
+    char fps_string[96];
     
     // Control.
     int w_pressed      = 0;
@@ -211,14 +904,26 @@ void Engine_run(struct Engine *e) {
     int running = 1;
     SDL_Event event;
 
+    // Frames drawn but not presented yet, oldest first (see FrameTarget).
+    struct FrameTarget *queued[ENGINE_MAX_FRAMES_IN_FLIGHT];
+    int num_queued  = 0;
+    int frame_index = 0;
+
     while (running) {
+        TRACE_BEGIN(frame);
+
         frame_start = frame_end;
         frame_end   = SDL_GetPerformanceCounter();
         dt = (float)((frame_end - frame_start) * 1000 / (float)SDL_GetPerformanceFrequency());
-        sprintf(fps_string, "Impromptu | FPS: %d", (int)(1000.0 / dt));
+        sprintf(
+            fps_string, "Impromptu | FPS: %d | Hi-Z rejected blocks: %d | Overdraw: %.2f",
+            (int)(1000.0 / dt), e->stats.hiz_rejected_blocks, e->stats.pixels_covered ? (float)e->stats.pixels_passed / e->stats.pixels_covered : 0
+        );
         SDL_SetWindowTitle(e->window, fps_string);
 
         // Handle user input events.
+        TRACE_BEGIN(input);
+        PERF_BEGIN(input);
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)) {
                 running = 0;
@@ -234,6 +939,26 @@ void Engine_run(struct Engine *e) {
                 else if (event.key.keysym.sym == SDLK_1) e->wireframe           = e->wireframe           ? 0 : 1;
                 else if (event.key.keysym.sym == SDLK_2) e->backface_culling    = e->backface_culling    ? 0 : 1;
                 else if (event.key.keysym.sym == SDLK_3) e->show_vertex_normals = e->show_vertex_normals ? 0 : 1;
+                else if (event.key.keysym.sym == SDLK_4) e->multithreaded       = e->multithreaded       ? 0 : 1;
+                else if (event.key.keysym.sym == SDLK_6) e->hiz                 = e->hiz                 ? 0 : 1;
+                else if (event.key.keysym.sym == SDLK_7) e->deferred            = e->deferred            ? 0 : 1;
+                else if (event.key.keysym.sym == SDLK_8) e->front_to_back       = e->front_to_back       ? 0 : 1;
+                else if (event.key.keysym.sym == SDLK_0) e->show_stats          = e->show_stats          ? 0 : 1;
+
+                // Dump the last few seconds of timing spans (see trace.h).
+                else if (event.key.keysym.sym == SDLK_t) TRACE_DUMP(NULL);
+
+                // Cycle through the supported raster kernels (down to the scalar reference).
+                else if (event.key.keysym.sym == SDLK_5) {
+                    e->raster_kernel = e->raster_kernel == RASTER_KERNEL_SCALAR ? Raster_best_kernel() : e->raster_kernel - 1;
+                    printf("Engine_run: Using the %s raster kernel.\n", Raster_kernel_name(e->raster_kernel));
+                }
+
+                // Cycle through the depth buffer formats.
+                else if (event.key.keysym.sym == SDLK_9) {
+                    Raster_set_depth_format(e, (e->depth_format + 1) % RASTER_NUM_DEPTH_FORMATS);
+                    printf("Engine_run: Using a %s depth buffer.\n", Raster_depth_format_name(e->depth_format));
+                }
 
             } else if (event.type == SDL_KEYUP) {
                 if      (event.key.keysym.sym == SDLK_w)      w_pressed      = 0;
@@ -244,8 +969,13 @@ void Engine_run(struct Engine *e) {
                 else if (event.key.keysym.sym == SDLK_SPACE)  space_pressed  = 0;
             }
         }
+        PERF_END(input, PERF_STAGE_INPUT, 1);
+        TRACE_END(input, "input", 0);
 
         // --- CAMERA CONTROLS --- 
+
+        TRACE_BEGIN(camera);
+        PERF_BEGIN(camera);
         
         // Mouse.
         SDL_GetMouseState(&mouse_x, &mouse_y);
@@ -295,7 +1025,7 @@ void Engine_run(struct Engine *e) {
             camera_pos     = Vector3_add(camera_pos, move_direction);
         } 
 
-        //Model_rotate(model, 0, dt * 0.01, 0);
+        //Model_rotate(scene->models[0], 0, dt * 0.01, 0);
 
         // Recompute view matrix.
         Matrix4_look_at(
@@ -309,261 +1039,166 @@ void Engine_run(struct Engine *e) {
         struct Matrix4 view_inv_transpose;
         Matrix4_inverse(&view, &view_inv);
         Matrix4_transpose(&view_inv, &view_inv_transpose);
+        PERF_END(camera, PERF_STAGE_CAMERA, 1);
+        TRACE_END(camera, "camera", 0);
+
+        _draw_scene(e, &sd, &view, camera_pos);
+
+        // Frame buffers are cleared tile by tile as they're rasterized (within the tile spans), so
+        // this only covers getting the target ready for it.
+        TRACE_BEGIN(clear);
+        PERF_BEGIN(clear);
+        struct FrameTarget *target = &e->targets[frame_index++ % e->frames_in_flight];
+        _begin_frame(e, target);
+        PERF_END(clear, PERF_STAGE_CLEAR, 1);
+        TRACE_END(clear, "clear", 0);
+
+        // Tiles are disjoint, so they are cleared and rasterized without any locking. Meanwhile,
+        // the oldest frame waiting is presented if the queue is full, which is when presenting
+        // (and waiting for the display) overlaps with drawing.
+        TRACE_BEGIN(raster);
+        PERF_BEGIN(raster);
+        if (e->multithreaded) {
+            ThreadPool_start(e->pool, _raster_tile_job, e, e->num_tiles);
+        } else {
+            for (int i = 0; i < e->num_tiles; ++i) {
+                _raster_tile_job(e, i, 0);
+            }
+        }
+        if (num_queued > 0 && num_queued >= e->frames_in_flight - 1) {
+            _present_frame(e, queued[0]);
+            --num_queued;
+            memmove(&queued[0], &queued[1], sizeof(struct FrameTarget *) * num_queued);
+        }
+        if (e->multithreaded) {
+            ThreadPool_wait(e->pool);
+        }
+        PERF_END(raster, PERF_STAGE_RASTER, 0);
+        TRACE_END(raster, "raster", 0);
+        queued[num_queued++] = target;
+
+        _gather_stats(e);
+        Perf_add_units(PERF_STAGE_RASTER, e->stats.pixels_tested);
+        if (e->show_stats) {
+            Overlay_draw_stats(e, &e->stats, dt);
+        }
 
+        // Without frames in flight, the frame is presented as soon as it's drawn.
+        if (num_queued == e->frames_in_flight) {
+            _present_frame(e, queued[0]);
+            --num_queued;
+            memmove(&queued[0], &queued[1], sizeof(struct FrameTarget *) * num_queued);
+        }
 
-        struct Matrix4 model_inv;
-        struct Matrix4 model_inv_transpose;
-        Matrix4_inverse(&model->model_to_world, &model_inv);
-        Matrix4_transpose(&model_inv, &model_inv_transpose);
+        TRACE_END(frame, "frame", 0);
+    }
 
-        // Clear frame buffers.
-        memset(e->color_buffer, 0, e->color_buffer_size);
-        for (int i = 0; i < e->num_window_pixels; ++i) {
-            e->depth_buffer[i] = -1.0;
+    // Frames still waiting to be presented are dropped.
+    for (int i = 0; i < ENGINE_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (e->targets[i].locked) {
+            SDL_UnlockTexture(e->targets[i].texture);
+            e->targets[i].locked = 0;
         }
+    }
 
-        // The following is something like a rendering pipeline. Specifically, the one specified in OpenGL.
-        for (int i = 0; i < model->num_tris; ++i) {
-            struct Tri t = model->mesh[i]; // Copy.
-
-            struct Vector3 v0 = t.v0.pos;
-            struct Vector3 v1 = t.v1.pos;
-            struct Vector3 v2 = t.v2.pos;
-            
-            struct Vector3 c0 = t.v0.col;
-            struct Vector3 c1 = t.v1.col;
-            struct Vector3 c2 = t.v2.col;
-
-            struct Vector3 n0 = t.v0.norm;
-            struct Vector3 n1 = t.v1.norm;
-            struct Vector3 n2 = t.v2.norm;
-            
-            // Apply Model-View-Projection (MVP) to the three vertices and normals.     
-
-            // Model.       
-            v0 = Matrix4_vmul(&model->model_to_world, v0);
-            v1 = Matrix4_vmul(&model->model_to_world, v1);
-            v2 = Matrix4_vmul(&model->model_to_world, v2);
-
-            // Normals to world space via inverse transpose of model.
-            n0 = Matrix4_vmul(&model->model_to_world, n0);
-            n1 = Matrix4_vmul(&model->model_to_world, n1);
-            n2 = Matrix4_vmul(&model->model_to_world, n2);
+    _end_scene(&sd);
+    Scene_destroy(scene);
 
-            if (e->backface_culling) {
-                struct Vector3 plane_normal = Vector3_cross(Vector3_sub(v1, v0), Vector3_sub(v2, v0));
-                struct Vector3 cam_ray = Vector3_sub(v0, camera_pos);
+    TRACE_DUMP("trace.json");
+    Perf_report();
 
-                // If face isn't facing camera, don't proceed (back-face culling).
-                if (Vector3_dot(plane_normal, cam_ray) >= 0) {
-                    continue;
-                }
-            }
+    return 0;
+}
 
-            // For rendering normals in world space. These are locations of vertices plus their normals.
-            // They are treated as any other vertex from this point on and processed in the pipeline.
-            
-            // Draw as 0.2 unit length vectors.
-            n0 = Vector3_smul(n0, 0.02);
-            n1 = Vector3_smul(n1, 0.02);
-            n2 = Vector3_smul(n2, 0.02);
-
-            struct Vector3 vn0 = Vector3_add(v0, n0);
-            struct Vector3 vn1 = Vector3_add(v1, n1);
-            struct Vector3 vn2 = Vector3_add(v2, n2);
-            
-            
-            // View.
-            v0 = Matrix4_vmul(&view, v0);
-            v1 = Matrix4_vmul(&view, v1);
-            v2 = Matrix4_vmul(&view, v2);
-
-            vn0 = Matrix4_vmul(&view, vn0);
-            vn1 = Matrix4_vmul(&view, vn1);
-            vn2 = Matrix4_vmul(&view, vn2);
-
-            // Projection.
-            v0 = Matrix4_vmul(&projection, v0);
-            v1 = Matrix4_vmul(&projection, v1);
-            v2 = Matrix4_vmul(&projection, v2);
-
-            vn0 = Matrix4_vmul(&projection, vn0);
-            vn1 = Matrix4_vmul(&projection, vn1);
-            vn2 = Matrix4_vmul(&projection, vn2);
+float Engine_render_path(struct Engine *e, struct Scene *scene, const struct CameraPath *path, int num_frames, int format, const char *directory, FILE *stream, struct FrameRecord *records) {
+    printf("Engine_render_path: Rendering %d frames%s%s.\n", num_frames, directory ? " to " : stream ? " to a stream" : "", directory ? directory : "");
 
-            // -- CULL IN CLIP SPACE --
-            // 
-            // If the entire triangle is outside the view frustrum, don't even bother with
-            // perspective divide and rasterization.
+    struct _SceneDraw sd;
+    _begin_scene(e, scene, &sd);
 
-            // Entire triangle is out left.
-            if (v0.x < -v0.w && 
-                v1.x < -v1.w && 
-                v2.x < -v2.w) {
-                continue;
-            }
+    // Frames are written as soon as they're drawn, so one target is enough.
+    struct FrameTarget *target = &e->targets[0];
 
-            // Entire triangle is out right.
-            if (v0.x > v0.w && 
-                v1.x > v1.w && 
-                v2.x > v2.w) {
-                continue;
-            }
+    Uint64 draw_ticks = 0;
+    int    failed     = 0;
+    for (int i = 0; i < num_frames && !failed; ++i) {
+        struct CameraKey key = CameraPath_sample(path, num_frames > 1 ? (float)i / (num_frames - 1) : 0);
 
-            // Entire triangle is out top.
-            if (v0.y < -v0.w && 
-                v1.y < -v1.w && 
-                v2.y < -v2.w) {
-                continue;
-            }
+        struct Matrix4 view;
+        Matrix4_look_at(key.position, key.target, Vector3_create_direction(0, 1, 0), &view);
 
-            // Entire triangle is out bottom.
-            if (v0.y > v0.w && 
-                v1.y > v1.w && 
-                v2.y > v2.w) {
-                continue;
-            }
+        TRACE_BEGIN(frame);
 
-            // Triangle is out near.
-            // Cull the triangle even if only one vertex is out.
-            if (v0.z < 0 || 
-                v1.z < 0 || 
-                v2.z < 0) {
-                continue;
-            }
+        Uint64 start = SDL_GetPerformanceCounter();
+        _draw_scene(e, &sd, &view, key.position);
+        _begin_frame(e, target);
 
-            // Entire triangle is out far.
-            if (v0.z > v0.w && 
-                v1.z > v1.w && 
-                v2.z > v2.w) {
-                continue;
+        TRACE_BEGIN(raster);
+        PERF_BEGIN(raster);
+        if (e->multithreaded) {
+            ThreadPool_run(e->pool, _raster_tile_job, e, e->num_tiles);
+        } else {
+            for (int j = 0; j < e->num_tiles; ++j) {
+                _raster_tile_job(e, j, 0);
             }
+        }
+        PERF_END(raster, PERF_STAGE_RASTER, 0);
+        TRACE_END(raster, "raster", 0);
+        _gather_stats(e);
+        Perf_add_units(PERF_STAGE_RASTER, e->stats.pixels_tested);
+
+        Uint64 ticks = SDL_GetPerformanceCounter() - start;
+        draw_ticks += ticks;
+        if (records) {
+            records[i].ms    = (float)ticks * 1000 / SDL_GetPerformanceFrequency();
+            records[i].stats = e->stats;
+        }
 
-            // --- PERSPECTIVE DIVIDE ---
-
-            v0 = Vector3_smul(v0, 1 / v0.w);
-            v1 = Vector3_smul(v1, 1 / v1.w);
-            v2 = Vector3_smul(v2, 1 / v2.w);
-
-            vn0 = Vector3_smul(vn0, 1 / vn0.w);
-            vn1 = Vector3_smul(vn1, 1 / vn1.w);
-            vn2 = Vector3_smul(vn2, 1 / vn2.w);
-            
-
-            // --- NORMALIZED DEVICE COORDINATE SPACE ----
-
-            // Apply viewport transform to obtain screen coordinates.
-            v0 = Matrix4_vmul(&viewport, v0);
-            v1 = Matrix4_vmul(&viewport, v1);
-            v2 = Matrix4_vmul(&viewport, v2);
-
-            vn0 = Matrix4_vmul(&viewport, vn0);
-            vn1 = Matrix4_vmul(&viewport, vn1);
-            vn2 = Matrix4_vmul(&viewport, vn2);
-
-            // --- SCREEN SPACE ----
+        // Not part of drawing the frame.
+        if (e->show_stats) {
+            Overlay_draw_stats(e, &e->stats, (float)ticks * 1000 / SDL_GetPerformanceFrequency());
+        }
 
-            // Draw vertex normals.
-            if (e->show_vertex_normals) {
-                Engine_bresenham(e, v0.x, v0.y, vn0.x, vn0.y, 255, 255, 255);
-                Engine_bresenham(e, v1.x, v1.y, vn1.x, vn1.y, 255, 255, 255);
-                Engine_bresenham(e, v2.x, v2.y, vn2.x, vn2.y, 255, 255, 255);
-            }
+        if (!directory && !stream) {
+            TRACE_END(frame, "frame", 0);
+            continue;
+        }
 
-            // --- RASTERIZE TRIANGLE ---
-            if (e->wireframe) {
-                Engine_raster_tri_wireframe(e, v0, v1, v2, 255, 255, 255);
-                continue;
-            }
-            
-            float x1 = v0.x;
-            float y1 = v0.y;
-            float z1 = v0.z;
-
-            float x2 = v1.x;
-            float y2 = v1.y;
-            float z2 = v1.z;
-
-            float x3 = v2.x;
-            float y3 = v2.y;
-            float z3 = v2.z;
-
-            // Transform unit normals (components in range [-1, 1]) to be suitable for colouring (components in range [0, 1]).
-            n0 = Vector3_add(Vector3_smul(Vector3_normalize(n0), 0.5), (struct Vector3){0.5, 0.5, 0.5});
-            n1 = Vector3_add(Vector3_smul(Vector3_normalize(n1), 0.5), (struct Vector3){0.5, 0.5, 0.5});
-            n2 = Vector3_add(Vector3_smul(Vector3_normalize(n2), 0.5), (struct Vector3){0.5, 0.5, 0.5});
-
-            // Finding bounding box of triangle (also considering the bounds of the screen).
-            float bb_min_x = MAX(MIN(MIN(x1, x2), x3), 0);
-            float bb_max_x = MIN(MAX(MAX(x1, x2), x3), e->window_width);
-            float bb_min_y = MAX(MIN(MIN(y1, y2), y3), 0);
-            float bb_max_y = MIN(MAX(MAX(y1, y2), y3), e->window_height);
-            
-            float px, py;
-            float w0, w1, w2;
-            float buffer_depth;
-
-            float area_inv = 1 / _edge(x1, y1, x2, y2, x3, y3);
-
-            // Interpolated values.
-            float z;
-            int r, g, b;
-            float nx, ny, nz;
-
-            for (int y = bb_min_y; y < bb_max_y; ++y) {
-                for (int x = bb_min_x; x < bb_max_x; ++x) {
-                    px = x + 0.5;
-                    py = y + 0.5;
-                    w0 = _edge(x2, y2, x3, y3, px, py);
-                    w1 = _edge(x3, y3, x1, y1, px, py);
-                    w2 = _edge(x1, y1, x2, y2, px, py);
-                    if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                        // Barycentric coordinates.
-                        w0 *= area_inv;
-                        w1 *= area_inv;
-                        w2 *= area_inv;
-
-                        // Interpolate depth.
-                        z = z1 * w0 + z2 * w1 + z3 * w2;
-
-                        // Interpolate colour.
-                        r = c0.x * w0 + c1.x * w1 + c2.x * w2;
-                        g = c0.y * w0 + c1.y * w1 + c2.y * w2;
-                        b = c0.z * w0 + c1.z * w1 + c2.z * w2;
-
-                        // Interpolate normal.
-                        nx = n0.x * w0 + n1.x * w1 + n2.x * w2;
-                        ny = n0.y * w0 + n1.y * w1 + n2.y * w2;
-                        nz = n0.z * w0 + n1.z * w1 + n2.z * w2;
-
-                        buffer_depth = e->depth_buffer[(e->window_width * y) + x];
-
-                        // Depth test.
-                        if (z < buffer_depth || buffer_depth == -1) {
-                            // The following is something like a fragment shader.
-                            Engine_set_pixel(e, x, y, nx * 255, ny * 255, nz * 255);
-                            Engine_set_depth(e, x, y, z);
-                        }
-                    }
-                }
+        TRACE_BEGIN(write);
+
+        FILE *file = stream;
+        if (directory) {
+            char file_name[1024];
+            snprintf(file_name, sizeof(file_name), "%s/frame_%05d.%s", directory, i, Image_format_name(format));
+            file = fopen(file_name, "wb");
+            if (!file) {
+                printf("Engine_render_path: Couldn't open %s.\n", file_name);
+                failed = 1;
+                break;
             }
         }
+        failed = Image_write(file, format, e->color_buffer, e->window_width, e->window_height, e->color_pitch) != 0;
+        if (directory) {
+            fclose(file);
+        } else {
+            fflush(file);
+        }
+        TRACE_END(write, "write", 0);
 
-        // Copy pixels to texture.
-        //SDL_UpdateTexture(e->frame_texture, NULL, e->color_buffer, e->window_width * 4);
-        unsigned char *locked_pixels;
-        int pitch; // Dummy.
-        SDL_LockTexture(e->frame_texture, NULL, (void**)&locked_pixels, &pitch);
-        memcpy(locked_pixels, e->color_buffer, e->color_buffer_size);
-        SDL_UnlockTexture(e->frame_texture);
+        TRACE_END(frame, "frame", 0);
+    }
 
-        // Copy texture to renderer.
-        SDL_RenderCopy(e->renderer, e->frame_texture, NULL, NULL);
-        
-        // Present renderer.
-        SDL_RenderPresent(e->renderer);
+    _end_scene(&sd);
+
+    if (failed) {
+        printf("Engine_render_path: Writing frames failed.\n");
+        return 0;
     }
 
-    // TEMPORARY.
-    Model_destroy(model);
+    float seconds = (float)draw_ticks / SDL_GetPerformanceFrequency();
+    float fps     = seconds > 0 ? num_frames / seconds : 0;
+    int   threads = e->multithreaded ? e->pool->num_threads : 1;
+    printf("Engine_render_path: Drew %d frames in %.3f s, %.1f frames/s (%.1f per thread).\n", num_frames, seconds, fps, fps / threads);
+
+    return fps;
 }
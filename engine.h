@@ -7,14 +7,67 @@
 #include <SDL2/SDL.h>
 
 #include "model.h"
+#include "scene.h"
 #include "vector3.h"
 #include "transform.h"
 #include "util.h"
 #include "light.h"
+#include "raster.h"
+#include "clip.h"
+#include "thread_pool.h"
+#include "camera_path.h"
+#include "image.h"
+#include "trace.h"
+#include "perf.h"
+
+// Most frames that can be drawn or waiting to be presented at once (see Engine_run).
+#define ENGINE_MAX_FRAMES_IN_FLIGHT 3
+
+// Frustum tests whole triangles are culled by (see EngineStats).
+#define ENGINE_CULL_LEFT   0
+#define ENGINE_CULL_RIGHT  1
+#define ENGINE_CULL_TOP    2
+#define ENGINE_CULL_BOTTOM 3
+#define ENGINE_CULL_NEAR   4
+#define ENGINE_CULL_FAR    5
+
+// What became of a frame's triangles and pixels at each stage of the pipeline.
+struct EngineStats {
+    // Triangles, in the order they drop out. Clipping can split triangles, so the pieces are
+    // counted from there on.
+    int tris_submitted;         // In the levels of detail drawn of models the scene's BVH found in view.
+    int tris_model_culled;      // In models whose bounds are outside the frustum.
+    int tris_meshlet_culled;    // In meshlets whose bounds are outside the frustum, or facing away.
+    int tris_backface_culled;
+    int tris_frustum_culled[6]; // Entirely outside a frustum plane (one of ENGINE_CULL_*).
+    int tris_clipped;           // Crossing the near plane or the guard band, and clipped.
+    int tris_clipped_away;      // Clipped, with nothing left.
+    int tris_rasterized;        // Handed to the rasterizer, pieces of clipped triangles included.
+    int tris_hiz_rejected;      // Rasterized, but entirely behind the Hi-Z buffer.
+
+    // Pixels (see Tile). pixels_passed / pixels_covered is the overdraw.
+    int pixels_tested;
+    int pixels_passed;
+    int pixels_shaded;
+    int pixels_covered;
+    int hiz_rejected_blocks;
+};
+
+// Where a frame is drawn: straight into its texture's locked memory when the texture's rows fit a
+// frame row, or into a staging buffer that is copied to the texture when the frame is presented.
+struct FrameTarget {
+    SDL_Texture   *texture;
+    unsigned char *staging;
+    void          *pixels; // Locked texture memory (if locked).
+    int            pitch;
+    int            locked;
+    int            direct; // Drawn into pixels rather than staging.
+};
 
 struct Engine {
     SDL_Window   *window;
     SDL_Renderer *renderer;
+    int           headless; // No window, renderer or frame textures (see Engine_create_headless).
 
     // Window.
     int   window_width;
@@ -25,25 +78,99 @@ struct Engine {
     float aspect_ratio;
 
     // Buffers.
-    SDL_Texture   *frame_texture;
-    unsigned char *color_buffer;
-    float         *depth_buffer;
+    unsigned char *color_buffer; // The current frame's target, color_pitch bytes per row.
+    int            color_pitch;
+    void          *depth_buffer; // In depth_format.
+    uint32_t      *vis_buffer; // Index of the RasterTri visible at each pixel (deferred mode only).
     size_t         color_buffer_size;
     size_t         depth_buffer_size;
+    size_t         vis_buffer_size;
+
+    // Colour targets of the frames in flight. While one frame is drawn, up to frames_in_flight - 1
+    // earlier ones wait to be presented, so presenting overlaps with drawing.
+    struct FrameTarget targets[ENGINE_MAX_FRAMES_IN_FLIGHT];
+    int                frames_in_flight;
+
+    // Depth buffer format (one of RASTER_DEPTH_*), the value depths are cleared to (the farthest)
+    // and the scale from z / w to the format's units (see Raster_set_depth_format).
+    int   depth_format;
+    float depth_far;
+    float depth_scale;
+
+    // Hierarchical Z: farthest depth of each BLOCK_SIZE x BLOCK_SIZE block (see raster.c).
+    float         *hiz_buffer;
+    unsigned char *hiz_dirty;
+    int            hiz_width;
+    int            hiz_height;
+
+    // Screen tiles (see raster.h).
+    struct Tile *tiles;
+    int          num_tiles_x;
+    int          num_tiles_y;
+    int          num_tiles;
+
+    // Post-transform vertices of the current model, one per unique vertex (see Engine_run).
+    struct Vector3 *post_pos;  // Clip space with the viewport folded in.
+    struct Vector3 *post_norm; // World space normals remapped to [0, 1] for colouring.
+    struct Vector3 *post_tip;  // Tips of the vertex normals (only if show_vertex_normals).
+    uint32_t       *post_stamp; // Vertices transformed for the current model hold post_stamp_value (when meshlets are culled).
+    uint32_t        post_stamp_value;
+    int             post_capacity;
+
+    // Meshlets of the current model that survived culling, and their CLIP_* visibility.
+    int           *visible_meshlets;
+    unsigned char *visible_meshlet_clip;
+    int            visible_meshlets_capacity;
+
+    // Vertices of the current frame's clipped triangles.
+    struct ClipVertex *clip_vertices;
+    int                num_clip_vertices;
+    int                clip_vertices_capacity;
+
+    // Screen space triangles of the current frame.
+    struct RasterTri *raster_tris;
+    int               num_raster_tris;
+    int               raster_tris_capacity;
+
+    // Order in which the triangles are binned when sorting front to back.
+    int      *raster_order;
+    int      *raster_order_tmp;
+    uint32_t *raster_sort_keys;
+    int       raster_order_capacity;
+
+    // Workers for rasterizing tiles.
+    struct ThreadPool *pool;
+
+    // Statistics of the last frame.
+    struct EngineStats stats;
 
     // Controls.
     float move_speed;
     float look_speed;
 
+    // Distances to the near and far planes. The far plane isn't used with reversed Z.
+    float z_near;
+    float z_far;
+
+    // Load options.
+    int optimize_meshes; // Reorder triangles for vertex cache locality and less overdraw (see model.h).
+
     // Render options.
     int wireframe;
     int backface_culling;
     int show_vertex_normals;
+    int multithreaded;
+    int raster_kernel; // One of RASTER_KERNEL_*.
+    int hiz;
+    int deferred; // Rasterize depth and triangle IDs only, then shade every pixel once.
+    int front_to_back;
+    int show_stats; // Draw the last frame's statistics over it (see overlay.h).
 };
 
 // We move Engine instances with heap pointers.
 
 struct Engine *Engine_create(int window_width, int window_height);
+struct Engine *Engine_create_headless(int width, int height); // No SDL video, window or textures.
 void           Engine_destroy(struct Engine *e);
 
 // Raster.
@@ -53,6 +180,20 @@ inline float   Engine_get_depth(struct Engine *e, int x, int y);
 inline void    Engine_bresenham(struct Engine *e, int x1, int y1, int x2, int y2, int r, int g, int b);
 inline void    Engine_raster_tri_wireframe(struct Engine *e, struct Vector3 v1, struct Vector3 v2, struct Vector3 v3, int r, int g, int b);
 
-void           Engine_run(struct Engine *e);
+// Runs the interactive engine until the window is closed. Returns 0, or -1 if the scene can't be loaded.
+int            Engine_run(struct Engine *e);
+
+// Measurements of a frame drawn by Engine_render_path.
+struct FrameRecord {
+    float              ms; // Spent drawing, from transforming vertices to rasterizing (not writing).
+    struct EngineStats stats;
+};
+
+// Renders num_frames frames of the scene along the camera path, spaced evenly from end to end,
+// and writes them as IMAGE_* images: to directory as frame_00000.<format> and so on, or one after
+// another to stream if directory is NULL. Nothing is written if both are NULL. records, if not
+// NULL, gets one per frame. Works with headless engines. Returns the frames drawn per second,
+// not counting writing them, or 0 if writing failed.
+float          Engine_render_path(struct Engine *e, struct Scene *scene, const struct CameraPath *path, int num_frames, int format, const char *directory, FILE *stream, struct FrameRecord *records);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "image.h"
+
+// PNG's zlib stream uses stored (uncompressed) deflate blocks, which hold at most this many bytes.
+// That keeps the writer small and fast, at the cost of file size.
+#define PNG_BLOCK_SIZE 65535
+
+static uint32_t _crc_table[256];
+static int      _crc_table_ready = 0;
+
+static uint32_t _crc(uint32_t crc, const unsigned char *data, size_t n) {
+    if (!_crc_table_ready) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            _crc_table[i] = c;
+        }
+        _crc_table_ready = 1;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i) {
+        crc = _crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t _adler(uint32_t adler, const unsigned char *data, size_t n) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    for (size_t i = 0; i < n; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void _put_u32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// Writes a chunk's length, type and data. Its CRC covers the type and data, so it's left to the caller.
+static uint32_t _chunk_begin(FILE *file, const char *type, uint32_t length) {
+    unsigned char header[8];
+    _put_u32(header, length);
+    memcpy(&header[4], type, 4);
+    fwrite(header, 1, 8, file);
+    return _crc(0, &header[4], 4);
+}
+
+static void _chunk_end(FILE *file, uint32_t crc) {
+    unsigned char footer[4];
+    _put_u32(footer, crc);
+    fwrite(footer, 1, 4, file);
+}
+
+static void _write_png(FILE *file, const unsigned char *rgba, int width, int height, int pitch) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, 8, file);
+
+    // 8 bit RGB, no interlacing.
+    unsigned char ihdr[13] = {0};
+    _put_u32(&ihdr[0], width);
+    _put_u32(&ihdr[4], height);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    uint32_t crc = _chunk_begin(file, "IHDR", 13);
+    fwrite(ihdr, 1, 13, file);
+    _chunk_end(file, _crc(crc, ihdr, 13));
+
+    // Rows are each prefixed with their filter type (none).
+    size_t row_size = 1 + (size_t)width * 3;
+    size_t raw_size = row_size * height;
+    unsigned char *raw = malloc(raw_size);
+    for (int y = 0; y < height; ++y) {
+        unsigned char       *dst = &raw[row_size * y];
+        const unsigned char *src = &rgba[(size_t)pitch * y];
+        *dst++ = 0;
+        for (int x = 0; x < width; ++x) {
+            *dst++ = src[x * 4 + 0];
+            *dst++ = src[x * 4 + 1];
+            *dst++ = src[x * 4 + 2];
+        }
+    }
+
+    // zlib header, stored blocks (each with a 5 byte header) and the Adler-32 of the data.
+    size_t num_blocks = MAX(1, (raw_size + PNG_BLOCK_SIZE - 1) / PNG_BLOCK_SIZE);
+    crc = _chunk_begin(file, "IDAT", 2 + raw_size + 5 * num_blocks + 4);
+
+    unsigned char zlib_header[2] = {0x78, 0x01};
+    fwrite(zlib_header, 1, 2, file);
+    crc = _crc(crc, zlib_header, 2);
+
+    for (size_t i = 0; i < num_blocks; ++i) {
+        size_t offset = i * PNG_BLOCK_SIZE;
+        size_t n      = MIN(PNG_BLOCK_SIZE, raw_size - offset);
+
+        unsigned char block_header[5] = {i + 1 == num_blocks, n & 0xFF, n >> 8, ~n & 0xFF, (~n >> 8) & 0xFF};
+        fwrite(block_header, 1, 5, file);
+        fwrite(&raw[offset], 1, n, file);
+        crc = _crc(crc, block_header, 5);
+        crc = _crc(crc, &raw[offset], n);
+    }
+
+    unsigned char adler[4];
+    _put_u32(adler, _adler(1, raw, raw_size));
+    fwrite(adler, 1, 4, file);
+    _chunk_end(file, _crc(crc, adler, 4));
+
+    _chunk_end(file, _chunk_begin(file, "IEND", 0));
+
+    free(raw);
+}
+
+int Image_write(FILE *file, int format, const unsigned char *rgba, int width, int height, int pitch) {
+    if (format == IMAGE_PNG) {
+        _write_png(file, rgba, width, height, pitch);
+    } else if (format == IMAGE_RAW) {
+        for (int y = 0; y < height; ++y) {
+            fwrite(&rgba[(size_t)pitch * y], 1, (size_t)width * 4, file);
+        }
+    } else {
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        unsigned char *row = malloc((size_t)width * 3);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                memcpy(&row[x * 3], &rgba[(size_t)pitch * y + x * 4], 3);
+            }
+            fwrite(row, 1, (size_t)width * 3, file);
+        }
+        free(row);
+    }
+
+    return ferror(file) ? -1 : 0;
+}
+
+const char *Image_format_name(int format) {
+    switch (format) {
+        case IMAGE_PNG: return "png";
+        case IMAGE_RAW: return "raw";
+        default:        return "ppm";
+    }
+}
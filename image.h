@@ -0,0 +1,23 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+
+// Image file formats. PPM and PNG keep RGB, raw keeps RGBA as is, with no header.
+#define IMAGE_PPM 0
+#define IMAGE_PNG 1
+#define IMAGE_RAW 2
+
+#define IMAGE_NUM_FORMATS 3
+
+// Writes an RGBA image with pitch bytes per row. Returns 0 on success, -1 if writing failed.
+int         Image_write(FILE *file, int format, const unsigned char *rgba, int width, int height, int pitch);
+
+const char *Image_format_name(int format); // Also the file extension.
+
+#endif
@@ -0,0 +1,75 @@
+#include "instances.h"
+
+struct Instances *Instances_create(struct Model *m) {
+    struct Instances *inst = malloc(sizeof(struct Instances));
+
+    inst->model    = m;
+    inst->count    = 0;
+    inst->capacity = 16;
+
+    inst->transforms     = malloc(sizeof(struct Matrix4) * inst->capacity);
+    inst->colours        = NULL;
+    inst->lods           = malloc(sizeof(int) * inst->capacity);
+    inst->sphere_centers = malloc(sizeof(struct Vector3) * inst->capacity);
+    inst->sphere_radii   = malloc(sizeof(float) * inst->capacity);
+
+    return inst;
+}
+
+void Instances_destroy(struct Instances *inst) {
+    Model_destroy(inst->model);
+    free(inst->transforms);
+    free(inst->colours);
+    free(inst->lods);
+    free(inst->sphere_centers);
+    free(inst->sphere_radii);
+    free(inst);
+}
+
+int Instances_add(struct Instances *inst, const struct Matrix4 *transform, const struct Vector3 *colour) {
+    if (inst->count == inst->capacity) {
+        inst->capacity *= 2;
+        inst->transforms     = realloc(inst->transforms,     sizeof(struct Matrix4) * inst->capacity);
+        inst->lods           = realloc(inst->lods,           sizeof(int) * inst->capacity);
+        inst->sphere_centers = realloc(inst->sphere_centers, sizeof(struct Vector3) * inst->capacity);
+        inst->sphere_radii   = realloc(inst->sphere_radii,   sizeof(float) * inst->capacity);
+        if (inst->colours) {
+            inst->colours = realloc(inst->colours, sizeof(struct Vector3) * inst->capacity);
+        }
+    }
+
+    // Colours are only stored once some instance has one.
+    if (colour && !inst->colours) {
+        inst->colours = malloc(sizeof(struct Vector3) * inst->capacity);
+        for (int i = 0; i < inst->count; ++i) {
+            inst->colours[i] = Vector3_create_direction(1, 1, 1);
+        }
+    }
+
+    int i = inst->count++;
+    if (inst->colours) {
+        inst->colours[i] = colour ? *colour : Vector3_create_direction(1, 1, 1);
+    }
+    inst->lods[i] = 0;
+    Instances_set_transform(inst, i, transform);
+
+    return i;
+}
+
+void Instances_set_transform(struct Instances *inst, int i, const struct Matrix4 *transform) {
+    const struct Model *m = inst->model;
+
+    Matrix4_copy(transform, &inst->transforms[i]);
+    inst->sphere_centers[i] = Matrix4_vmul(transform, m->sphere_center);
+    inst->sphere_radii[i]   = m->sphere_radius * Matrix4_max_scale(transform);
+}
+
+int Instances_frustum_query(const struct Instances *inst, const struct Vector3 planes[6], int *out) {
+    int n = 0;
+    for (int i = 0; i < inst->count; ++i) {
+        if (Clip_test_sphere(planes, inst->sphere_centers[i], inst->sphere_radii[i]) != CLIP_OUTSIDE) {
+            out[n++] = i;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,42 @@
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "model.h"
+#include "matrix4.h"
+#include "clip.h"
+#include "util.h"
+
+// Many copies of one model's mesh, each with its own transform and, optionally, colour. The
+// copies share the mesh (vertices, levels of detail and meshlets), so each one costs a transform,
+// its bounds and a level of detail. The model's own transform is not used.
+struct Instances {
+    struct Model *model;
+
+    struct Matrix4 *transforms; // Model to world, one per instance.
+    struct Vector3 *colours;    // Multiplies the shading (components in [0, 1]). NULL until an instance gets one.
+    int            *lods;       // Level of detail each instance was drawn with last (see Model_select_lod).
+    int             count;
+    int             capacity;
+
+    // World space bounding spheres, kept up to date with the transforms for culling.
+    struct Vector3 *sphere_centers;
+    float          *sphere_radii;
+};
+
+// We move Instances instances with heap pointers.
+
+struct Instances *Instances_create(struct Model *m); // Takes ownership of the model.
+void              Instances_destroy(struct Instances *inst); // Destroys the model as well.
+
+// Adds an instance and returns its index. colour may be NULL (white, leaving the shading as is).
+int               Instances_add(struct Instances *inst, const struct Matrix4 *transform, const struct Vector3 *colour);
+void              Instances_set_transform(struct Instances *inst, int i, const struct Matrix4 *transform);
+
+// Instances whose bounding spheres are not entirely outside the frustum planes (see
+// Clip_frustum_planes). out must have room for count of them.
+int               Instances_frustum_query(const struct Instances *inst, const struct Vector3 planes[6], int *out);
+
+#endif
@@ -1,16 +1,146 @@
+// For dup, dup2 and fdopen, to keep stdout for frames when they're written there.
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <SDL2/SDL.h>
 
 #include "engine.h"
+#include "raster.h"
 #include "obj_parse.h"
 
+// Most --model options in headless mode.
+#define MAX_MODELS 64
+
+// The index of the name an option's value matches, out of count names. Otherwise prints the names
+// and returns -1.
+static int _parse_name(const char *option, const char *value, const char *(*name)(int), int count) {
+    for (int i = 0; i < count; ++i) {
+        if (strcmp(value, name(i)) == 0) return i;
+    }
+
+    printf("main: Unknown %s %s (expected", option, value);
+    for (int i = 0; i < count; ++i) {
+        printf("%s %s", i == 0 ? "" : ",", name(i));
+    }
+    printf(").\n");
+    return -1;
+}
+
 int main(int argc, char *argv[]) {
-    struct Engine *e = Engine_create(3840 / 2, 2160 / 2);
+    int optimize_meshes  = 0;
+    int frames_in_flight = 0; // The engine's default.
+    int depth_format     = RASTER_DEPTH_FLOAT;
+    int show_stats       = 0;
+    int perf_counters    = 0;
+
+    // Headless rendering (see Engine_render_path).
+    int         headless    = 0;
+    int         width       = 3840 / 2; // Also the window's size.
+    int         height      = 2160 / 2;
+    int         num_frames  = 60;
+    int         format      = IMAGE_PPM;
+    const char *output      = ".";  // Directory, or - for stdout.
+    const char *camera_path = NULL; // Orbits the scene if NULL.
+    const char *models[MAX_MODELS];
+    int         num_models  = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--optimize-meshes") == 0) optimize_meshes = 1;
+        if (strcmp(argv[i], "--stats") == 0) show_stats = 1;
+        if (strcmp(argv[i], "--perf-counters") == 0) perf_counters = 1;
+        if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) frames_in_flight = atoi(argv[++i]);
+        if (strcmp(argv[i], "--depth-format") == 0 && i + 1 < argc) {
+            depth_format = _parse_name(argv[i], argv[i + 1], Raster_depth_format_name, RASTER_NUM_DEPTH_FORMATS);
+            ++i;
+            if (depth_format < 0) return EXIT_FAILURE;
+        }
+
+        if (strcmp(argv[i], "--headless") == 0) headless = 1;
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) sscanf(argv[++i], "%dx%d", &width, &height);
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) num_frames = atoi(argv[++i]);
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output = argv[++i];
+        if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) camera_path = argv[++i];
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc && num_models < MAX_MODELS) models[num_models++] = argv[++i];
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = _parse_name(argv[i], argv[i + 1], Image_format_name, IMAGE_NUM_FORMATS);
+            ++i;
+            if (format < 0) return EXIT_FAILURE;
+        }
+    }
+
+    // Frames written to stdout keep it to themselves, and everything printed goes to stderr.
+    FILE *stream = NULL;
+    if (headless && strcmp(output, "-") == 0) {
+        stream = fdopen(dup(fileno(stdout)), "wb");
+        dup2(fileno(stderr), fileno(stdout));
+    }
+
+    // Before the engine's thread pool, so its threads are counted.
+    if (perf_counters) {
+        Perf_open();
+    }
+
+    struct Engine *e = headless ? Engine_create_headless(width, height) : Engine_create(width, height);
+
+    e->optimize_meshes = optimize_meshes;
+    e->show_stats      = show_stats;
+    if (frames_in_flight > 0) {
+        e->frames_in_flight = MIN(ENGINE_MAX_FRAMES_IN_FLIGHT, frames_in_flight);
+    }
+    Raster_set_depth_format(e, depth_format);
+
+    if (!headless) {
+        int result = Engine_run(e);
+        Engine_destroy(e);
+        Perf_close();
+        return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    struct Scene *scene = Scene_create();
+    if (num_models == 0) {
+        models[num_models++] = "models/casa.obj";
+    }
+    for (int i = 0; i < num_models; ++i) {
+        struct Model *model = Model_from_obj(models[i], 0, 0, 0, 0, 0, 0, 1, 1, 1);
+        if (!model) {
+            printf("main: Couldn't load %s.\n", models[i]);
+            if (stream) fclose(stream);
+            Scene_destroy(scene);
+            Engine_destroy(e);
+            Perf_close();
+            return EXIT_FAILURE;
+        }
+        Scene_add(scene, model);
+    }
+    Scene_update(scene);
+
+    // Without a camera path, orbit the scene from far enough away to see all of it, and keep all
+    // of it in front of the far plane.
+    struct CameraPath *path = camera_path ? CameraPath_from_file(camera_path) : NULL;
+    if (!path) {
+        if (camera_path) printf("main: Couldn't read a camera path from %s, orbiting instead.\n", camera_path);
+
+        struct Vector3 min, max;
+        Scene_bounds(scene, &min, &max);
+        struct Vector3 center = Vector3_smul(Vector3_add(min, max), 0.5);
+        float          radius = Vector3_norm(Vector3_sub(max, min)) * 0.5;
+
+        path = CameraPath_orbit(center, radius * 1.5, radius * 0.5);
+        e->z_far = MAX(e->z_far, radius * 4);
+    }
+
+    float fps = Engine_render_path(e, scene, path, num_frames, format, stream ? NULL : output, stream, NULL);
+    TRACE_DUMP("trace.json");
+    Perf_report();
 
-    Engine_run(e);
+    if (stream) fclose(stream);
+    CameraPath_destroy(path);
+    Scene_destroy(scene);
     Engine_destroy(e);
+    Perf_close();
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    return fps > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
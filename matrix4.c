@@ -143,6 +143,15 @@ inline float Matrix4_tr(const struct Matrix4 *a) {
     return a->x00 + a->x11 + a->x22 + a->x33;
 }
 
+inline float Matrix4_max_scale(const struct Matrix4 *a) {
+    // Longest column of the upper 3 x 3 part. Exact for compositions of scales, rotations and
+    // translations, but it doesn't account for shear.
+    float x = a->x00 * a->x00 + a->x10 * a->x10 + a->x20 * a->x20;
+    float y = a->x01 * a->x01 + a->x11 * a->x11 + a->x21 * a->x21;
+    float z = a->x02 * a->x02 + a->x12 * a->x12 + a->x22 * a->x22;
+    return sqrtf(x > y ? (x > z ? x : z) : (y > z ? y : z));
+}
+
 float Matrix4_det(const struct Matrix4 *m) {
     // We compute, arbitrarily, along the 0th row.
 
@@ -28,6 +28,7 @@ inline void           Matrix4_smul(const struct Matrix4 *a, float s, struct Matr
 inline struct Vector3 Matrix4_vmul(const struct Matrix4 *a, struct Vector3 v);
 inline void           Matrix4_transpose(const struct Matrix4 *a, struct Matrix4 *out);
 inline float          Matrix4_tr(const struct Matrix4 *a);
+inline float          Matrix4_max_scale(const struct Matrix4 *a); // Largest factor the matrix scales lengths by.
 inline float          Matrix4_det(const struct Matrix4 *a);
 inline void           Matrix4_inverse(const struct Matrix4 *a, struct Matrix4 *out);
 inline void           Matrix4_copy(const struct Matrix4 *a, struct Matrix4 *out);
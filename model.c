@@ -1,6 +1,8 @@
 #include "model.h"
 
-struct Model *Model_create(struct Tri *mesh, int num_tris, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz) {
+static void _build_meshlets(const struct Model *m, struct ModelLod *lod); // See below.
+
+struct Model *Model_create(struct Vertex *vertices, int num_vertices, uint32_t *indices, int num_tris, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz) {
     struct Model *out = malloc(sizeof(struct Model));
 
     // Build the model matrix.
@@ -15,24 +17,68 @@ struct Model *Model_create(struct Tri *mesh, int num_tris, float x, float y, flo
     struct Matrix4 scale_then_rotate;
     Matrix4_mul(&rotate, &scale, &scale_then_rotate);
     Matrix4_mul(&translate, &scale_then_rotate, &out->model_to_world);
+    out->transform_changed = 1;
+    out->loaded            = 0;
+
+    out->vertices     = vertices;
+    out->num_vertices = num_vertices;
+
+    // The full mesh is the first level of detail.
+    out->lods[0].indices  = indices;
+    out->lods[0].num_tris = num_tris;
+    out->lods[0].error    = 0;
+    out->num_lods         = 1;
+    out->lod              = 0;
+    _build_meshlets(out, &out->lods[0]);
 
-    out->mesh = mesh;
-    out->num_tris = num_tris;
+    // Bounds. The sphere is centered on the box, which is close enough to minimal for culling.
+    out->aabb_min = Vector3_create_point(0, 0, 0);
+    out->aabb_max = Vector3_create_point(0, 0, 0);
+    for (int i = 0; i < num_vertices; ++i) {
+        struct Vector3 p = vertices[i].pos;
+        if (i == 0) {
+            out->aabb_min = p;
+            out->aabb_max = p;
+        }
+        out->aabb_min = (struct Vector3){MIN(out->aabb_min.x, p.x), MIN(out->aabb_min.y, p.y), MIN(out->aabb_min.z, p.z), 1};
+        out->aabb_max = (struct Vector3){MAX(out->aabb_max.x, p.x), MAX(out->aabb_max.y, p.y), MAX(out->aabb_max.z, p.z), 1};
+    }
+
+    out->sphere_center = Vector3_smul(Vector3_add(out->aabb_min, out->aabb_max), 0.5);
+    out->sphere_radius = 0;
+    for (int i = 0; i < num_vertices; ++i) {
+        out->sphere_radius = MAX(out->sphere_radius, Vector3_norm(Vector3_sub(vertices[i].pos, out->sphere_center)));
+    }
 
     return out;
 }
 
 struct Model *Model_from_obj(const char *file_name, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz) {
-    int num_tris;
+    struct Vertex *vertices;
+    int            num_vertices;
+    uint32_t      *indices;
+    int            num_tris;
     
-    struct Tri   *mesh = parse_obj(file_name, &num_tris);
-    struct Model *out  = Model_create(mesh, num_tris, x, y, z, rx, ry, rz, sx, sy, sz);
+    if (parse_obj(file_name, &vertices, &num_vertices, &indices, &num_tris) != 0) {
+        return NULL;
+    }
+    struct Model *out = Model_create(vertices, num_vertices, indices, num_tris, x, y, z, rx, ry, rz, sx, sy, sz);
+
+    char *cache_file_name = malloc(strlen(file_name) + 5);
+    sprintf(cache_file_name, "%s.lod", file_name);
+    Model_build_lods(out, cache_file_name);
+    free(cache_file_name);
 
     return out;
 }
 
 void Model_destroy(struct Model *m) {
-    free(m->mesh);
+    free(m->vertices);
+    for (int l = 0; l < m->num_lods; ++l) {
+        free(m->lods[l].indices);
+        free(m->lods[l].meshlets);
+        free(m->lods[l].meshlet_vertices);
+    }
     free(m);
 }
 
@@ -43,18 +89,1086 @@ inline void Model_translate(struct Model *m, float delta_x, float delta_y, float
     // We have to apply the model transform before translation since scaling and rotation
     // are relative to (0, 0, 0) in model coordinates.
     Matrix4_mul(&translate, &m->model_to_world, &m->model_to_world);
+    m->transform_changed = 1;
 }
 
 inline void Model_rotate(struct Model *m, float delta_rx, float delta_ry, float delta_rz) {
     struct Matrix4 rotate;
     Matrix4_rotate_xyz(delta_rx, delta_ry, delta_rz, &rotate);
     Matrix4_mul(&m->model_to_world, &rotate, &m->model_to_world);
+    m->transform_changed = 1;
 }
 
 inline void Model_scale(struct Model *m, float delta_sx, float delta_sy, float delta_sz) {
     struct Matrix4 scale;
     Matrix4_scale(delta_sx, delta_sy, delta_sz, &scale);
     Matrix4_mul(&m->model_to_world, &scale, &m->model_to_world);
+    m->transform_changed = 1;
+}
+
+// Meshlets.
+//
+// Meshlets are grown greedily from a seed triangle (the first one left, in the current order) over
+// triangles sharing a vertex position with them, preferring triangles that share more of their
+// vertices, face the same way as the meshlet and are close to its center. Positions rather than vertex indices are used for
+// connectivity, so meshes with split normals are clustered as well.
+
+struct _WeldVertex {
+    float x, y, z;
+    int   index;
+};
+
+static int _compare_weld_vertices(const void *a, const void *b) {
+    const struct _WeldVertex *va = a;
+    const struct _WeldVertex *vb = b;
+    if (va->x != vb->x) return va->x < vb->x ? -1 : 1;
+    if (va->y != vb->y) return va->y < vb->y ? -1 : 1;
+    if (va->z != vb->z) return va->z < vb->z ? -1 : 1;
+    return 0;
+}
+
+// Numbers the distinct vertex positions, writing the number of each vertex's position to pos_id.
+// Returns how many there are.
+static int _weld(const struct Model *m, int *pos_id) {
+    int nv = m->num_vertices;
+
+    struct _WeldVertex *weld = malloc(sizeof(struct _WeldVertex) * MAX(nv, 1));
+    for (int v = 0; v < nv; ++v) {
+        weld[v] = (struct _WeldVertex){m->vertices[v].pos.x, m->vertices[v].pos.y, m->vertices[v].pos.z, v};
+    }
+    qsort(weld, nv, sizeof(struct _WeldVertex), _compare_weld_vertices);
+
+    int num_pos = 0;
+    for (int i = 0; i < nv; ++i) {
+        if (i > 0 && _compare_weld_vertices(&weld[i - 1], &weld[i]) != 0) ++num_pos;
+        pos_id[weld[i].index] = num_pos;
+    }
+
+    free(weld);
+    return num_pos + (nv > 0);
+}
+
+// Bounding sphere and normal cone of a finished meshlet (see struct Meshlet).
+static void _meshlet_bounds(const struct Model *m, const struct ModelLod *lod, struct Meshlet *ml, const uint32_t *indices, const struct Vector3 *normals, const int *tris) {
+    const uint32_t *mv = &lod->meshlet_vertices[ml->first_vertex];
+
+    struct Vector3 min = m->vertices[mv[0]].pos;
+    struct Vector3 max = min;
+    for (int i = 1; i < ml->num_vertices; ++i) {
+        struct Vector3 p = m->vertices[mv[i]].pos;
+        min = (struct Vector3){MIN(min.x, p.x), MIN(min.y, p.y), MIN(min.z, p.z), 1};
+        max = (struct Vector3){MAX(max.x, p.x), MAX(max.y, p.y), MAX(max.z, p.z), 1};
+    }
+
+    ml->center = Vector3_smul(Vector3_add(min, max), 0.5);
+    ml->radius = 0;
+    for (int i = 0; i < ml->num_vertices; ++i) {
+        ml->radius = MAX(ml->radius, Vector3_norm(Vector3_sub(m->vertices[mv[i]].pos, ml->center)));
+    }
+
+    // The axis is the average normal. Degenerate triangles (zero normals) are never drawn, so they
+    // don't constrain the cone.
+    struct Vector3 axis = {0, 0, 0, 0};
+    for (int i = 0; i < ml->num_tris; ++i) {
+        axis = Vector3_add(axis, normals[tris[i]]);
+    }
+
+    ml->cone_apex   = ml->center;
+    ml->cone_axis   = Vector3_create_direction(0, 0, 0);
+    ml->cone_cutoff = 2;
+
+    float axis_norm = Vector3_norm(axis);
+    if (axis_norm == 0) {
+        return;
+    }
+    axis = Vector3_smul(axis, 1 / axis_norm);
+
+    float min_dot = 1;
+    for (int i = 0; i < ml->num_tris; ++i) {
+        struct Vector3 n = normals[tris[i]];
+        if (n.x != 0 || n.y != 0 || n.z != 0) {
+            min_dot = MIN(min_dot, Vector3_dot(n, axis));
+        }
+    }
+
+    // Normals spread over a hemisphere or more always have one facing the camera.
+    if (min_dot <= 0) {
+        return;
+    }
+
+    // Move the apex back along the axis until it is behind every triangle's plane, so that a
+    // camera seeing the apex from behind sees every triangle from behind too.
+    float max_t = 0;
+    for (int i = 0; i < ml->num_tris; ++i) {
+        struct Vector3 n = normals[tris[i]];
+        float dn = Vector3_dot(n, axis);
+        if (dn > 0) {
+            struct Vector3 p0 = m->vertices[indices[3 * tris[i]]].pos;
+            max_t = MAX(max_t, Vector3_dot(Vector3_sub(ml->center, p0), n) / dn);
+        }
+    }
+
+    ml->cone_apex   = Vector3_sub(ml->center, Vector3_smul(axis, max_t));
+    ml->cone_axis   = axis;
+    ml->cone_cutoff = sqrtf(1 - min_dot * min_dot); // Sine of the cone's half angle.
+}
+
+// Partitions the triangles of a level of detail into meshlets, reordering them.
+static void _build_meshlets(const struct Model *m, struct ModelLod *lod) {
+    int nv = m->num_vertices;
+    int nt = lod->num_tris;
+
+    lod->meshlets         = malloc(sizeof(struct Meshlet) * MAX(nt, 1));
+    lod->meshlet_vertices = malloc(sizeof(uint32_t) * MAX(3 * nt, 1));
+    lod->num_meshlets     = 0;
+
+    int *pos_id  = malloc(sizeof(int) * MAX(nv, 1));
+    int  num_pos = _weld(m, pos_id);
+
+    // Triangles around each position.
+    int *adj_start = calloc(num_pos + 1, sizeof(int));
+    int *adj_fill  = malloc(sizeof(int) * MAX(num_pos, 1));
+    int *adj       = malloc(sizeof(int) * MAX(3 * nt, 1));
+
+    for (int i = 0; i < 3 * nt; ++i) {
+        ++adj_start[pos_id[lod->indices[i]] + 1];
+    }
+    for (int p = 0; p < num_pos; ++p) {
+        adj_start[p + 1] += adj_start[p];
+        adj_fill[p]       = adj_start[p];
+    }
+    for (int i = 0; i < 3 * nt; ++i) {
+        int p = pos_id[lod->indices[i]];
+        adj[adj_fill[p]++] = i / 3;
+    }
+
+    // Unit face normals, wound as in back-face culling.
+    struct Vector3 *normals   = malloc(sizeof(struct Vector3) * MAX(nt, 1));
+    struct Vector3 *centroids = malloc(sizeof(struct Vector3) * MAX(nt, 1));
+    for (int t = 0; t < nt; ++t) {
+        struct Vector3 p0 = m->vertices[lod->indices[3 * t + 0]].pos;
+        struct Vector3 p1 = m->vertices[lod->indices[3 * t + 1]].pos;
+        struct Vector3 p2 = m->vertices[lod->indices[3 * t + 2]].pos;
+
+        struct Vector3 n = Vector3_cross(Vector3_sub(p1, p0), Vector3_sub(p2, p0));
+        float n_norm = Vector3_norm(n);
+        normals[t] = n_norm > 0 ? Vector3_smul(n, 1 / n_norm) : n;
+        centroids[t] = Vector3_smul(Vector3_add(Vector3_add(p0, p1), p2), 1.0f / 3);
+    }
+
+    // Which meshlet last used each vertex and position.
+    int *vertex_meshlet = malloc(sizeof(int) * MAX(nv, 1));
+    int *pos_meshlet    = malloc(sizeof(int) * MAX(num_pos, 1));
+    for (int v = 0; v < nv; ++v)      vertex_meshlet[v] = -1;
+    for (int p = 0; p < num_pos; ++p) pos_meshlet[p]    = -1;
+
+    char     *assigned   = calloc(MAX(nt, 1), 1);
+    int      *tris       = malloc(sizeof(int) * MAX(nt, 1)); // Triangles in meshlet order.
+    uint32_t *out        = malloc(sizeof(uint32_t) * MAX(3 * nt, 1));
+    int       num_out    = 0;
+    int       num_mv     = 0;
+    int       next_seed  = 0;
+
+    // Unassigned triangles around the current meshlet (and some assigned ones, removed lazily).
+    int  candidates_capacity = 256;
+    int *candidates          = malloc(sizeof(int) * candidates_capacity);
+
+    while (num_out < nt) {
+        int id = lod->num_meshlets++;
+        struct Meshlet *ml = &lod->meshlets[id];
+        ml->first_tri    = num_out;
+        ml->num_tris     = 0;
+        ml->first_vertex = num_mv;
+        ml->num_vertices = 0;
+
+        struct Vector3 normal_sum   = {0, 0, 0, 0};
+        struct Vector3 centroid_sum = {0, 0, 0, 0};
+        float          spread       = 0; // Distance of the farthest triangle from the center.
+        int            num_candidates = 0;
+
+        while (assigned[next_seed]) ++next_seed;
+        int t = next_seed;
+
+        while (t >= 0) {
+            assigned[t] = 1;
+            tris[num_out++] = t;
+            ++ml->num_tris;
+            normal_sum   = Vector3_add(normal_sum, normals[t]);
+            centroid_sum = Vector3_add(centroid_sum, centroids[t]);
+
+            for (int k = 0; k < 3; ++k) {
+                int v = lod->indices[3 * t + k];
+                if (vertex_meshlet[v] != id) {
+                    vertex_meshlet[v] = id;
+                    lod->meshlet_vertices[num_mv++] = v;
+                    ++ml->num_vertices;
+                }
+
+                // Triangles around a new position become candidates.
+                int p = pos_id[v];
+                if (pos_meshlet[p] != id) {
+                    pos_meshlet[p] = id;
+                    for (int a = adj_start[p]; a < adj_start[p + 1]; ++a) {
+                        if (assigned[adj[a]]) continue;
+                        if (num_candidates == candidates_capacity) {
+                            candidates_capacity *= 2;
+                            candidates = realloc(candidates, sizeof(int) * candidates_capacity);
+                        }
+                        candidates[num_candidates++] = adj[a];
+                    }
+                }
+            }
+
+            if (ml->num_tris == MESHLET_MAX_TRIS) {
+                break;
+            }
+
+            float normal_sum_norm = Vector3_norm(normal_sum);
+            struct Vector3 axis = normal_sum_norm > 0 ? Vector3_smul(normal_sum, 1 / normal_sum_norm) : normal_sum;
+
+            struct Vector3 center = Vector3_smul(centroid_sum, 1.0f / ml->num_tris);
+            spread = MAX(spread, Vector3_norm(Vector3_sub(centroids[tris[num_out - 1]], center)));
+
+            t = -1;
+            float best_score = -INFINITY;
+            for (int c = num_candidates - 1; c >= 0; --c) {
+                int ct = candidates[c];
+                if (assigned[ct]) {
+                    candidates[c] = candidates[--num_candidates];
+                    continue;
+                }
+
+                int shared = 0;
+                for (int k = 0; k < 3; ++k) {
+                    shared += pos_meshlet[pos_id[lod->indices[3 * ct + k]]] == id;
+                }
+
+                float facing = Vector3_dot(normals[ct], axis);
+                if (ml->num_tris >= MESHLET_MIN_TRIS && facing < MESHLET_MIN_FACING) {
+                    continue;
+                }
+
+                // Far away candidates are penalized relative to the meshlet's current size, which
+                // keeps meshlets round and their cones narrow.
+                float distance = Vector3_norm(Vector3_sub(centroids[ct], center));
+                float score    = shared + facing - (spread > 0 ? distance / spread : 0);
+                if (score > best_score) {
+                    best_score = score;
+                    t = ct;
+                }
+            }
+
+            // Top up small meshlets of disconnected pieces with the next triangles in order.
+            if (t < 0 && ml->num_tris < MESHLET_MIN_TRIS) {
+                while (next_seed < nt && assigned[next_seed]) ++next_seed;
+                if (next_seed < nt) t = next_seed;
+            }
+        }
+
+        for (int i = ml->first_tri; i < num_out; ++i) {
+            memcpy(&out[3 * i], &lod->indices[3 * tris[i]], sizeof(uint32_t) * 3);
+        }
+        _meshlet_bounds(m, lod, ml, lod->indices, normals, &tris[ml->first_tri]);
+    }
+
+    free(lod->indices);
+    lod->indices = out;
+
+    lod->meshlets         = realloc(lod->meshlets, sizeof(struct Meshlet) * MAX(lod->num_meshlets, 1));
+    lod->meshlet_vertices = realloc(lod->meshlet_vertices, sizeof(uint32_t) * MAX(num_mv, 1));
+
+    free(pos_id);
+    free(adj_start);
+    free(adj_fill);
+    free(adj);
+    free(normals);
+    free(centroids);
+    free(vertex_meshlet);
+    free(pos_meshlet);
+    free(assigned);
+    free(tris);
+    free(candidates);
+}
+
+// Levels of detail.
+//
+// Each level is simplified from the one before by edge collapses ordered by quadric error (Garland
+// and Heckbert, "Surface Simplification Using Quadric Error Metrics"). Edges collapse onto one of
+// their endpoints, so no vertex is moved or created and every level indexes the model's vertices.
+// Collapses are done in passes: every edge is costed, then the cheapest ones are collapsed as long
+// as they don't touch the triangles around one another, which saves keeping a priority queue up to
+// date. Quadrics accumulate across levels, so errors are relative to the full mesh. A level's
+// error is the largest root mean square distance from a collapsed position to its planes.
+//
+// Connectivity is by position, so that vertices split by normals collapse together. Each vertex
+// at a collapsed position is replaced by the one at the target position with the closest normal.
+// Open borders get extra quadrics that hold them in place.
+
+#define LOD_BORDER_WEIGHT 10.0
+#define LOD_MAX_PASSES    64
+#define LOD_MIN_REDUCTION 0.9f // Levels that keep more of the previous level's triangles are dropped.
+#define LOD_CACHE_MAGIC   "IMPLOD1"
+
+// Sum of squared distances to a set of planes, as a symmetric 4 x 4 matrix, and the number of
+// planes of triangles (the error is the mean over those; see _quadric_error).
+struct _Quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double count;
+};
+
+static void _quadric_add_plane(struct _Quadric *q, struct Vector3 n, double d, double weight, int triangle) {
+    double a = n.x, b = n.y, c = n.z;
+    q->count += triangle;
+    q->a2 += weight * a * a; q->ab += weight * a * b; q->ac += weight * a * c; q->ad += weight * a * d;
+    q->b2 += weight * b * b; q->bc += weight * b * c; q->bd += weight * b * d;
+    q->c2 += weight * c * c; q->cd += weight * c * d;
+    q->d2 += weight * d * d;
+}
+
+static void _quadric_add(struct _Quadric *q, const struct _Quadric *r) {
+    q->a2 += r->a2; q->ab += r->ab; q->ac += r->ac; q->ad += r->ad;
+    q->b2 += r->b2; q->bc += r->bc; q->bd += r->bd;
+    q->c2 += r->c2; q->cd += r->cd;
+    q->d2 += r->d2;
+    q->count += r->count;
+}
+
+// Mean squared distance from p to the planes of two quadrics. Border planes weigh in the sum but not
+// the count, which keeps borders expensive to move.
+static double _quadric_error(const struct _Quadric *q, const struct _Quadric *r, struct Vector3 p) {
+    double x = p.x, y = p.y, z = p.z;
+    double a2 = q->a2 + r->a2, ab = q->ab + r->ab, ac = q->ac + r->ac, ad = q->ad + r->ad;
+    double b2 = q->b2 + r->b2, bc = q->bc + r->bc, bd = q->bd + r->bd;
+    double c2 = q->c2 + r->c2, cd = q->cd + r->cd;
+    double d2 = q->d2 + r->d2;
+
+    double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z
+                 + d2;
+    double count = q->count + r->count;
+    return count > 0 ? MAX(error, 0) / count : 0;
+}
+
+struct _Edge {
+    int    from, to; // Positions.
+    int    count;    // Triangles sharing the edge.
+    double cost;
+};
+
+static int _compare_edge_positions(const void *a, const void *b) {
+    const struct _Edge *ea = a;
+    const struct _Edge *eb = b;
+    if (ea->from != eb->from) return ea->from < eb->from ? -1 : 1;
+    return (ea->to > eb->to) - (ea->to < eb->to);
+}
+
+static int _compare_edge_costs(const void *a, const void *b) {
+    double ca = ((const struct _Edge *)a)->cost;
+    double cb = ((const struct _Edge *)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+// Edges of the triangles (over positions tp), each once with from < to.
+static int _collect_edges(const int *tp, int nt, struct _Edge *edges) {
+    int n = 0;
+    for (int t = 0; t < nt; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            int a = tp[3 * t + k];
+            int b = tp[3 * t + (k + 1) % 3];
+            if (a != b) {
+                edges[n++] = (struct _Edge){MIN(a, b), MAX(a, b), 1, 0};
+            }
+        }
+    }
+    qsort(edges, n, sizeof(struct _Edge), _compare_edge_positions);
+
+    int unique = 0;
+    for (int i = 0; i < n; ++i) {
+        if (unique > 0 && edges[unique - 1].from == edges[i].from && edges[unique - 1].to == edges[i].to) {
+            ++edges[unique - 1].count;
+        } else {
+            edges[unique++] = edges[i];
+        }
+    }
+    return unique;
+}
+
+static struct Vector3 _face_normal(struct Vector3 p0, struct Vector3 p1, struct Vector3 p2) {
+    return Vector3_cross(Vector3_sub(p1, p0), Vector3_sub(p2, p0));
+}
+
+// Simplifies a triangle list (in place) down to about target triangles. Returns the number of
+// triangles left and raises *error to the largest collapse error.
+static int _simplify(const struct Model *m, uint32_t *indices, int nt, int target, const int *pos_id, int num_pos,
+                     const int *pos_vertex_start, const int *pos_vertices, const struct Vector3 *pos, struct _Quadric *quadrics, float *error) {
+    int nv = m->num_vertices;
+
+    int          *tp        = malloc(sizeof(int) * MAX(3 * nt, 1));
+    struct _Edge *edges     = malloc(sizeof(struct _Edge) * MAX(3 * nt, 1));
+    int          *adj_start = malloc(sizeof(int) * (num_pos + 1));
+    int          *adj       = malloc(sizeof(int) * MAX(3 * nt, 1));
+    int          *remap     = malloc(sizeof(int) * MAX(num_pos, 1));
+    char         *locked    = malloc(MAX(num_pos, 1));
+    int          *vertex_remap = malloc(sizeof(int) * MAX(nv, 1));
+
+    for (int pass = 0; pass < LOD_MAX_PASSES && nt > target; ++pass) {
+        for (int i = 0; i < 3 * nt; ++i) {
+            tp[i] = pos_id[indices[i]];
+        }
+
+        // Cost every edge, collapsing onto whichever endpoint is cheaper.
+        int num_edges = _collect_edges(tp, nt, edges);
+        for (int i = 0; i < num_edges; ++i) {
+            struct _Edge *e = &edges[i];
+            double to_cost   = _quadric_error(&quadrics[e->from], &quadrics[e->to], pos[e->to]);
+            double from_cost = _quadric_error(&quadrics[e->from], &quadrics[e->to], pos[e->from]);
+            if (from_cost < to_cost) {
+                int tmp = e->from;
+                e->from = e->to;
+                e->to   = tmp;
+            }
+            e->cost = MIN(to_cost, from_cost);
+        }
+        qsort(edges, num_edges, sizeof(struct _Edge), _compare_edge_costs);
+
+        // Triangles around each position.
+        memset(adj_start, 0, sizeof(int) * (num_pos + 1));
+        for (int i = 0; i < 3 * nt; ++i) {
+            ++adj_start[tp[i] + 1];
+        }
+        for (int p = 0; p < num_pos; ++p) {
+            adj_start[p + 1] += adj_start[p];
+        }
+        for (int i = 3 * nt - 1; i >= 0; --i) {
+            adj[--adj_start[tp[i] + 1]] = i / 3;
+        }
+        // Filling backwards moved each start one slot up.
+        for (int p = 0; p < num_pos; ++p) {
+            adj_start[p] = adj_start[p + 1];
+        }
+        adj_start[num_pos] = 3 * nt;
+
+        for (int p = 0; p < num_pos; ++p) {
+            remap[p]  = p;
+            locked[p] = 0;
+        }
+
+        int removed = 0;
+        for (int i = 0; i < num_edges && removed < nt - target; ++i) {
+            int from = edges[i].from;
+            int to   = edges[i].to;
+            if (locked[from] || locked[to]) {
+                continue;
+            }
+
+            // Triangles around from either disappear (they use the edge) or move one corner to
+            // to, which must not flip them.
+            int collapsed = 0;
+            int flips     = 0;
+            for (int a = adj_start[from]; a < adj_start[from + 1] && !flips; ++a) {
+                const int *q = &tp[3 * adj[a]];
+                if (q[0] == to || q[1] == to || q[2] == to) {
+                    ++collapsed;
+                    continue;
+                }
+
+                struct Vector3 p0 = pos[q[0]], p1 = pos[q[1]], p2 = pos[q[2]];
+                struct Vector3 before = _face_normal(p0, p1, p2);
+                if (q[0] == from) p0 = pos[to];
+                if (q[1] == from) p1 = pos[to];
+                if (q[2] == from) p2 = pos[to];
+                flips = Vector3_dot(before, _face_normal(p0, p1, p2)) <= 0;
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[from] = to;
+            _quadric_add(&quadrics[to], &quadrics[from]);
+            *error   = MAX(*error, sqrt(edges[i].cost));
+            removed += collapsed;
+
+            // Nothing else may change the triangles around from in this pass.
+            locked[from] = 1;
+            locked[to]   = 1;
+            for (int a = adj_start[from]; a < adj_start[from + 1]; ++a) {
+                const int *q = &tp[3 * adj[a]];
+                locked[q[0]] = locked[q[1]] = locked[q[2]] = 1;
+            }
+        }
+
+        if (removed == 0) {
+            break;
+        }
+
+        // Move vertices of collapsed positions, and drop the triangles that became degenerate.
+        for (int v = 0; v < nv; ++v) {
+            vertex_remap[v] = -1;
+        }
+
+        int n = 0;
+        for (int t = 0; t < nt; ++t) {
+            uint32_t tri[3];
+            int      tri_pos[3];
+            for (int k = 0; k < 3; ++k) {
+                int v = indices[3 * t + k];
+                int p = remap[pos_id[v]];
+                if (p != pos_id[v]) {
+                    if (vertex_remap[v] < 0) {
+                        // The vertex at the new position with the closest normal.
+                        float best = -INFINITY;
+                        for (int j = pos_vertex_start[p]; j < pos_vertex_start[p + 1]; ++j) {
+                            float d = Vector3_dot(m->vertices[v].norm, m->vertices[pos_vertices[j]].norm);
+                            if (d > best) {
+                                best = d;
+                                vertex_remap[v] = pos_vertices[j];
+                            }
+                        }
+                    }
+                    v = vertex_remap[v];
+                }
+                tri[k]     = v;
+                tri_pos[k] = p;
+            }
+
+            if (tri_pos[0] != tri_pos[1] && tri_pos[1] != tri_pos[2] && tri_pos[2] != tri_pos[0]) {
+                memcpy(&indices[3 * n], tri, sizeof(tri));
+                ++n;
+            }
+        }
+        nt = n;
+    }
+
+    free(tp);
+    free(edges);
+    free(adj_start);
+    free(adj);
+    free(remap);
+    free(locked);
+    free(vertex_remap);
+
+    return nt;
+}
+
+// Hash of what the levels of detail are built from (FNV-1a), to validate cache files.
+static uint32_t _lod_hash(const struct Model *m) {
+    uint32_t hash = 2166136261u;
+    const struct ModelLod *full = &m->lods[0];
+
+    for (int v = 0; v < m->num_vertices; ++v) {
+        float data[6] = {
+            m->vertices[v].pos.x,  m->vertices[v].pos.y,  m->vertices[v].pos.z,
+            m->vertices[v].norm.x, m->vertices[v].norm.y, m->vertices[v].norm.z
+        };
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < sizeof(data); ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    }
+    const unsigned char *bytes = (const unsigned char *)full->indices;
+    for (size_t i = 0; i < sizeof(uint32_t) * 3 * full->num_tris; ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Cache files hold a header (magic, vertex and triangle counts of the full mesh, hash and the
+// number of levels) followed by each simplified level's error, triangle count and indices.
+static int _read_lods(struct Model *m, const char *file_name, uint32_t hash) {
+    FILE *file = fopen(file_name, "rb");
+    if (!file) {
+        return 0;
+    }
+
+    char     magic[8];
+    uint32_t header[4];
+    int ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, LOD_CACHE_MAGIC, sizeof(magic)) == 0
+          && fread(header, sizeof(uint32_t), 4, file) == 4
+          && header[0] == (uint32_t)m->num_vertices && header[1] == (uint32_t)m->lods[0].num_tris && header[2] == hash
+          && header[3] < MODEL_MAX_LODS;
+
+    int num_lods = 1;
+    for (uint32_t l = 0; ok && l < header[3]; ++l) {
+        struct ModelLod *lod = &m->lods[num_lods];
+        uint32_t num_tris;
+        ok = fread(&lod->error, sizeof(float), 1, file) == 1 && fread(&num_tris, sizeof(uint32_t), 1, file) == 1
+          && num_tris <= (uint32_t)m->lods[0].num_tris;
+        if (!ok) {
+            break;
+        }
+
+        lod->num_tris = num_tris;
+        lod->indices  = malloc(sizeof(uint32_t) * MAX(3 * num_tris, 1));
+        ok = fread(lod->indices, sizeof(uint32_t), 3 * num_tris, file) == 3 * num_tris;
+        for (uint32_t i = 0; ok && i < 3 * num_tris; ++i) {
+            ok = lod->indices[i] < (uint32_t)m->num_vertices;
+        }
+        if (!ok) {
+            free(lod->indices);
+            break;
+        }
+        ++num_lods;
+    }
+    fclose(file);
+
+    if (!ok) {
+        for (int l = 1; l < num_lods; ++l) {
+            free(m->lods[l].indices);
+        }
+        return 0;
+    }
+
+    m->num_lods = num_lods;
+    return 1;
+}
+
+static void _write_lods(const struct Model *m, const char *file_name, uint32_t hash) {
+    FILE *file = fopen(file_name, "wb");
+    if (!file) {
+        return;
+    }
+
+    char     magic[8]  = LOD_CACHE_MAGIC;
+    uint32_t header[4] = {m->num_vertices, m->lods[0].num_tris, hash, m->num_lods - 1};
+    fwrite(magic, 1, sizeof(magic), file);
+    fwrite(header, sizeof(uint32_t), 4, file);
+
+    for (int l = 1; l < m->num_lods; ++l) {
+        const struct ModelLod *lod = &m->lods[l];
+        uint32_t num_tris = lod->num_tris;
+        fwrite(&lod->error, sizeof(float), 1, file);
+        fwrite(&num_tris, sizeof(uint32_t), 1, file);
+        fwrite(lod->indices, sizeof(uint32_t), 3 * num_tris, file);
+    }
+    fclose(file);
+}
+
+// Builds the simplified levels' indices (without meshlets).
+static void _simplify_lods(struct Model *m) {
+    int nv = m->num_vertices;
+    int nt = m->lods[0].num_tris;
+
+    int *pos_id  = malloc(sizeof(int) * MAX(nv, 1));
+    int  num_pos = _weld(m, pos_id);
+
+    // Vertices at each position, and the positions themselves.
+    int            *pos_vertex_start = calloc(num_pos + 1, sizeof(int));
+    int            *pos_vertices     = malloc(sizeof(int) * MAX(nv, 1));
+    struct Vector3 *pos              = malloc(sizeof(struct Vector3) * MAX(num_pos, 1));
+    for (int v = 0; v < nv; ++v) {
+        ++pos_vertex_start[pos_id[v] + 1];
+        pos[pos_id[v]] = m->vertices[v].pos;
+    }
+    for (int p = 0; p < num_pos; ++p) {
+        pos_vertex_start[p + 1] += pos_vertex_start[p];
+    }
+    for (int v = nv - 1; v >= 0; --v) {
+        pos_vertices[--pos_vertex_start[pos_id[v] + 1]] = v;
+    }
+    for (int p = 0; p < num_pos; ++p) {
+        pos_vertex_start[p] = pos_vertex_start[p + 1];
+    }
+    pos_vertex_start[num_pos] = nv;
+
+    // Plane quadrics of the full mesh's triangles, plus the planes through its border edges
+    // perpendicular to their triangle.
+    struct _Quadric *quadrics = calloc(MAX(num_pos, 1), sizeof(struct _Quadric));
+    int          *tp    = calloc(MAX(3 * nt, 1), sizeof(int));
+    struct _Edge *edges = malloc(sizeof(struct _Edge) * MAX(3 * nt, 1));
+    for (int i = 0; i < 3 * nt; ++i) {
+        tp[i] = pos_id[m->lods[0].indices[i]];
+    }
+    int num_edges = _collect_edges(tp, nt, edges);
+
+    for (int t = 0; t < nt; ++t) {
+        const int *q = &tp[3 * t];
+        struct Vector3 n = _face_normal(pos[q[0]], pos[q[1]], pos[q[2]]);
+        float n_norm = Vector3_norm(n);
+        if (n_norm == 0) {
+            continue;
+        }
+        n = Vector3_smul(n, 1 / n_norm);
+
+        for (int k = 0; k < 3; ++k) {
+            _quadric_add_plane(&quadrics[q[k]], n, -Vector3_dot(n, pos[q[0]]), 1, 1);
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            int a = q[k];
+            int b = q[(k + 1) % 3];
+            struct _Edge key = {MIN(a, b), MAX(a, b), 0, 0};
+            struct _Edge *edge = bsearch(&key, edges, num_edges, sizeof(struct _Edge), _compare_edge_positions);
+            if (a == b || !edge || edge->count != 1) {
+                continue;
+            }
+
+            struct Vector3 border = Vector3_cross(Vector3_sub(pos[b], pos[a]), n);
+            float border_norm = Vector3_norm(border);
+            if (border_norm > 0) {
+                border = Vector3_smul(border, 1 / border_norm);
+                _quadric_add_plane(&quadrics[a], border, -Vector3_dot(border, pos[a]), LOD_BORDER_WEIGHT, 0);
+                _quadric_add_plane(&quadrics[b], border, -Vector3_dot(border, pos[a]), LOD_BORDER_WEIGHT, 0);
+            }
+        }
+    }
+
+    // Each level starts from the previous one.
+    float ratios[] = MODEL_LOD_RATIOS;
+    float error    = 0;
+    uint32_t *indices = malloc(sizeof(uint32_t) * MAX(3 * nt, 1));
+    memcpy(indices, m->lods[0].indices, sizeof(uint32_t) * 3 * nt);
+
+    for (int l = 0; l < (int)(sizeof(ratios) / sizeof(ratios[0])) && m->num_lods < MODEL_MAX_LODS; ++l) {
+        int previous = m->lods[m->num_lods - 1].num_tris;
+        int target   = ratios[l] * nt;
+
+        int simplified = _simplify(m, indices, previous, target, pos_id, num_pos, pos_vertex_start, pos_vertices, pos, quadrics, &error);
+        if (simplified == 0 || simplified > LOD_MIN_REDUCTION * previous) {
+            break;
+        }
+
+        struct ModelLod *lod = &m->lods[m->num_lods++];
+        lod->num_tris = simplified;
+        lod->error    = error;
+        lod->indices  = malloc(sizeof(uint32_t) * 3 * simplified);
+        memcpy(lod->indices, indices, sizeof(uint32_t) * 3 * simplified);
+    }
+
+    free(pos_id);
+    free(pos_vertex_start);
+    free(pos_vertices);
+    free(pos);
+    free(quadrics);
+    free(tp);
+    free(edges);
+    free(indices);
+}
+
+void Model_build_lods(struct Model *m, const char *cache_file_name) {
+    uint32_t hash = _lod_hash(m);
+
+    if (!cache_file_name || !_read_lods(m, cache_file_name, hash)) {
+        _simplify_lods(m);
+        if (cache_file_name) {
+            _write_lods(m, cache_file_name, hash);
+        }
+    }
+
+    for (int l = 1; l < m->num_lods; ++l) {
+        _build_meshlets(m, &m->lods[l]);
+    }
+}
+
+int Model_select_lod(const struct Model *m, int lod, float pixels_per_unit) {
+    // Coarsest levels within the error threshold, and within it with the margin. Errors grow
+    // with the level.
+    int fit        = 0;
+    int fit_margin = 0;
+    for (int l = 1; l < m->num_lods; ++l) {
+        float pixels = m->lods[l].error * pixels_per_unit;
+        if (pixels <= MODEL_LOD_ERROR_PIXELS)                        fit        = l;
+        if (pixels <= MODEL_LOD_ERROR_PIXELS * MODEL_LOD_HYSTERESIS) fit_margin = l;
+    }
+
+    if (fit < lod) {
+        return fit; // Too coarse now, refine right away.
+    }
+    if (fit_margin > lod) {
+        return fit_margin;
+    }
+    return lod;
+}
+
+// Load-time triangle reordering.
+//
+// Model_optimize_vertex_cache is Forsyth's linear-speed vertex cache optimization: triangles are
+// emitted greedily by a score favouring vertices recently used (still in a simulated LRU cache) and
+// vertices with few triangles left. It runs within each meshlet. Model_optimize_overdraw then sorts
+// the meshlets as clusters so that clusters facing out of the mesh, which tend to occlude the rest,
+// are drawn first (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+
+#define OPT_CACHE_SIZE          32
+#define OPT_CACHE_DECAY_POWER   1.5f
+#define OPT_LAST_TRI_SCORE      0.75f
+#define OPT_VALENCE_BOOST_SCALE 2.0f
+#define OPT_VALENCE_BOOST_POWER 0.5f
+
+static float _vertex_score(int cache_pos, int valence) {
+    if (valence == 0) {
+        return -1; // No triangles left to use the vertex.
+    }
+
+    float score = 0;
+    if (cache_pos >= 0) {
+        if (cache_pos < 3) {
+            // The vertices of the last triangle get a fixed score so that its neighbours don't
+            // win just for sharing an edge.
+            score = OPT_LAST_TRI_SCORE;
+        } else {
+            score = powf(1 - (float)(cache_pos - 3) / (OPT_CACHE_SIZE - 3), OPT_CACHE_DECAY_POWER);
+        }
+    }
+
+    // Boost vertices with few triangles left, so they're finished off instead of lingering.
+    return score + OPT_VALENCE_BOOST_SCALE * powf(valence, -OPT_VALENCE_BOOST_POWER);
+}
+
+// Reorders the triangles of an index buffer using vertices [0, nv).
+static void _optimize_vertex_cache(uint32_t *indices, int nt, int nv) {
+
+    // Triangles adjacent to each vertex; the first valence[v] of them are the ones not yet emitted.
+    int *valence   = calloc(nv, sizeof(int));
+    int *adj_start = malloc(sizeof(int) * (nv + 1));
+    int *adj       = malloc(sizeof(int) * 3 * nt);
+
+    for (int i = 0; i < 3 * nt; ++i) {
+        ++valence[indices[i]];
+    }
+    adj_start[0] = 0;
+    for (int v = 0; v < nv; ++v) {
+        adj_start[v + 1] = adj_start[v] + valence[v];
+        valence[v] = 0;
+    }
+    for (int i = 0; i < 3 * nt; ++i) {
+        int v = indices[i];
+        adj[adj_start[v] + valence[v]++] = i / 3;
+    }
+
+    int   *cache_pos = malloc(sizeof(int) * nv);
+    float *v_score   = malloc(sizeof(float) * nv);
+    float *t_score   = malloc(sizeof(float) * nt);
+    char  *emitted   = calloc(nt, 1);
+
+    for (int v = 0; v < nv; ++v) {
+        cache_pos[v] = -1;
+        v_score[v]   = _vertex_score(-1, valence[v]);
+    }
+    for (int t = 0; t < nt; ++t) {
+        t_score[t] = v_score[indices[3 * t]] + v_score[indices[3 * t + 1]] + v_score[indices[3 * t + 2]];
+    }
+
+    // The cache briefly holds 3 extra entries while a triangle is pushed in.
+    int cache[OPT_CACHE_SIZE + 3];
+    int cache_len = 0;
+
+    uint32_t *out  = malloc(sizeof(uint32_t) * 3 * nt);
+    int best       = -1;
+    int next_unemitted = 0;
+
+    for (int n = 0; n < nt; ++n) {
+        if (best < 0) {
+            // Nothing in the cache has triangles left, so start anywhere (in the original order).
+            while (emitted[next_unemitted]) ++next_unemitted;
+            best = next_unemitted;
+        }
+
+        emitted[best] = 1;
+        for (int k = 0; k < 3; ++k) {
+            int v = indices[3 * best + k];
+            out[3 * n + k] = v;
+
+            // Remove the triangle from the vertex's remaining ones.
+            int *tris = &adj[adj_start[v]];
+            for (int j = 0; j < valence[v]; ++j) {
+                if (tris[j] == best) {
+                    tris[j] = tris[--valence[v]];
+                    break;
+                }
+            }
+        }
+
+        // Push the triangle's vertices to the front of the LRU cache.
+        int new_cache[OPT_CACHE_SIZE + 3];
+        int new_len = 0;
+        for (int k = 0; k < 3; ++k) {
+            new_cache[new_len++] = indices[3 * best + k];
+        }
+        for (int j = 0; j < cache_len; ++j) {
+            int v = cache[j];
+            if (v != new_cache[0] && v != new_cache[1] && v != new_cache[2]) {
+                new_cache[new_len++] = v;
+            }
+        }
+
+        // Rescore everything that was or is in the cache, and the triangles using it.
+        for (int j = 0; j < new_len; ++j) {
+            cache_pos[new_cache[j]] = j < OPT_CACHE_SIZE ? j : -1;
+        }
+        for (int j = 0; j < new_len; ++j) {
+            int v = new_cache[j];
+            v_score[v] = _vertex_score(cache_pos[v], valence[v]);
+        }
+
+        best = -1;
+        float best_score = -1;
+        for (int j = 0; j < new_len; ++j) {
+            int v = new_cache[j];
+            for (int a = 0; a < valence[v]; ++a) {
+                int t = adj[adj_start[v] + a];
+                t_score[t] = v_score[indices[3 * t]] + v_score[indices[3 * t + 1]] + v_score[indices[3 * t + 2]];
+                if (t_score[t] > best_score) {
+                    best_score = t_score[t];
+                    best       = t;
+                }
+            }
+        }
+
+        cache_len = MIN(new_len, OPT_CACHE_SIZE);
+        memcpy(cache, new_cache, sizeof(int) * cache_len);
+    }
+
+    memcpy(indices, out, sizeof(uint32_t) * 3 * nt);
+    free(out);
+
+    free(valence);
+    free(adj_start);
+    free(adj);
+    free(cache_pos);
+    free(v_score);
+    free(t_score);
+    free(emitted);
+}
+
+void Model_optimize_vertex_cache(struct Model *m) {
+    // Meshlets are optimized one by one, on their own vertices (numbered locally).
+    int      *local   = malloc(sizeof(int) * MAX(m->num_vertices, 1));
+    uint32_t *scratch = malloc(sizeof(uint32_t) * 3 * MESHLET_MAX_TRIS);
+
+    for (int l = 0; l < m->num_lods; ++l) {
+        struct ModelLod *lod = &m->lods[l];
+
+        for (int i = 0; i < lod->num_meshlets; ++i) {
+            const struct Meshlet *ml = &lod->meshlets[i];
+            const uint32_t *mv = &lod->meshlet_vertices[ml->first_vertex];
+            uint32_t *indices = &lod->indices[3 * ml->first_tri];
+
+            for (int v = 0; v < ml->num_vertices; ++v) {
+                local[mv[v]] = v;
+            }
+            for (int j = 0; j < 3 * ml->num_tris; ++j) {
+                scratch[j] = local[indices[j]];
+            }
+
+            _optimize_vertex_cache(scratch, ml->num_tris, ml->num_vertices);
+
+            for (int j = 0; j < 3 * ml->num_tris; ++j) {
+                indices[j] = mv[scratch[j]];
+            }
+        }
+    }
+
+    free(local);
+    free(scratch);
+}
+
+struct _Cluster {
+    int   meshlet;
+    float sort_key;
+};
+
+static int _compare_clusters(const void *a, const void *b) {
+    float ka = ((const struct _Cluster *)a)->sort_key;
+    float kb = ((const struct _Cluster *)b)->sort_key;
+    return (ka < kb) - (ka > kb); // Descending.
+}
+
+static void _optimize_overdraw(const struct Model *m, struct ModelLod *lod) {
+    int nt = lod->num_tris;
+    if (nt == 0) {
+        return;
+    }
+
+    // The clusters are the meshlets, which are spatially coherent and keep their vertex cache
+    // locality when reordered as a whole.
+    int num_clusters = lod->num_meshlets;
+    struct _Cluster *clusters = malloc(sizeof(struct _Cluster) * num_clusters);
+
+    // Mesh centroid.
+    struct Vector3 mesh_centroid = {0, 0, 0, 0};
+    for (int v = 0; v < m->num_vertices; ++v) {
+        mesh_centroid = Vector3_add(mesh_centroid, m->vertices[v].pos);
+    }
+    mesh_centroid = Vector3_smul(mesh_centroid, 1.0f / MAX(m->num_vertices, 1));
+
+    // Clusters far out along their own facing direction come first.
+    for (int c = 0; c < num_clusters; ++c) {
+        const struct Meshlet *ml = &lod->meshlets[c];
+        struct Vector3 centroid = {0, 0, 0, 0};
+        struct Vector3 normal   = {0, 0, 0, 0};
+        float total_area = 0;
+
+        clusters[c].meshlet = c;
+        for (int t = ml->first_tri; t < ml->first_tri + ml->num_tris; ++t) {
+            struct Vector3 p0 = m->vertices[lod->indices[3 * t + 0]].pos;
+            struct Vector3 p1 = m->vertices[lod->indices[3 * t + 1]].pos;
+            struct Vector3 p2 = m->vertices[lod->indices[3 * t + 2]].pos;
+
+            // Area weighted.
+            struct Vector3 n = Vector3_cross(Vector3_sub(p1, p0), Vector3_sub(p2, p0));
+            float area = Vector3_norm(n);
+
+            centroid = Vector3_add(centroid, Vector3_smul(Vector3_add(Vector3_add(p0, p1), p2), area / 3));
+            normal   = Vector3_add(normal, n);
+            total_area += area;
+        }
+
+        float normal_norm = Vector3_norm(normal);
+        clusters[c].sort_key = total_area > 0 && normal_norm > 0
+            ? Vector3_dot(Vector3_sub(Vector3_smul(centroid, 1 / total_area), mesh_centroid), Vector3_smul(normal, 1 / normal_norm))
+            : 0;
+    }
+
+    qsort(clusters, num_clusters, sizeof(struct _Cluster), _compare_clusters);
+
+    uint32_t       *out          = malloc(sizeof(uint32_t) * 3 * nt);
+    struct Meshlet *out_meshlets = malloc(sizeof(struct Meshlet) * num_clusters);
+    int n = 0;
+    for (int c = 0; c < num_clusters; ++c) {
+        struct Meshlet ml = lod->meshlets[clusters[c].meshlet];
+        memcpy(&out[3 * n], &lod->indices[3 * ml.first_tri], sizeof(uint32_t) * 3 * ml.num_tris);
+        ml.first_tri = n;
+        out_meshlets[c] = ml;
+        n += ml.num_tris;
+    }
+
+    free(lod->indices);
+    free(lod->meshlets);
+    lod->indices  = out;
+    lod->meshlets = out_meshlets;
+
+    free(clusters);
+}
+
+void Model_optimize_overdraw(struct Model *m) {
+    for (int l = 0; l < m->num_lods; ++l) {
+        _optimize_overdraw(m, &m->lods[l]);
+    }
+}
+
+float Model_acmr(const struct Model *m, int cache_size) {
+    int *fifo = malloc(sizeof(int) * cache_size);
+    int  fifo_len  = 0;
+    int  fifo_head = 0;
+    int  misses    = 0;
+
+    const struct ModelLod *lod = &m->lods[0];
+    for (int i = 0; i < 3 * lod->num_tris; ++i) {
+        int v = lod->indices[i];
+        int hit = 0;
+        for (int j = 0; j < fifo_len; ++j) hit |= fifo[j] == v;
+
+        if (!hit) {
+            ++misses;
+            fifo[fifo_head] = v;
+            fifo_head = (fifo_head + 1) % cache_size;
+            fifo_len  = MIN(fifo_len + 1, cache_size);
+        }
+    }
+
+    free(fifo);
+    return lod->num_tris ? (float)misses / lod->num_tris : 0;
 }
 
 // struct Model *Model_unit_cube() {
@@ -3,34 +3,126 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "matrix4.h"
 #include "vertex.h"
 #include "tri.h"
 #include "obj_parse.h"
+#include "util.h"
 
-struct Model {
-    struct Tri *mesh;
+// Meshlets are small clusters of triangles that are culled as a whole before their vertices are
+// transformed (see model.c). Meshlets are closed once they reach MESHLET_MIN_TRIS
+// triangles and their next triangle would widen the normal cone past MESHLET_MIN_FACING.
+#define MESHLET_MIN_TRIS     64
+#define MESHLET_MAX_TRIS     128
+#define MESHLET_MIN_FACING   0.7f
+
+// Margin on normal cone tests, which keeps them conservative with respect to float rounding.
+#define MESHLET_CONE_EPSILON 1e-3f
+
+// Triangle counts of the simplified levels of detail, relative to the full mesh.
+#define MODEL_LOD_RATIOS { 0.5f, 0.25f, 0.1f }
+
+#define MODEL_LOD_ERROR_PIXELS 1.0f
+#define MODEL_LOD_HYSTERESIS   0.75f
+
+struct Meshlet {
+    // Triangles [first_tri, first_tri + num_tris) of the model, which use the vertices
+    // meshlet_vertices[first_vertex, first_vertex + num_vertices).
+    int first_tri;
     int num_tris;
+    int first_vertex;
+    int num_vertices;
+
+    // Bounding sphere.
+    struct Vector3 center;
+    float          radius;
+
+    // Normal cone. Every triangle is back-facing from a camera at c when
+    // dot(normalize(cone_apex - c), cone_axis) >= cone_cutoff (a cutoff above 1 never culls).
+    struct Vector3 cone_apex;
+    struct Vector3 cone_axis;
+    float          cone_cutoff;
+};
+
+// Most levels of detail a model has, including the full mesh.
+#define MODEL_MAX_LODS 4
+
+// The triangles of a model at one level of detail, which all index the model's vertices.
+struct ModelLod {
+    // Triangle i is made of vertices indices[3 * i], indices[3 * i + 1] and indices[3 * i + 2].
+    uint32_t *indices;
+    int       num_tris;
+
+    // Triangles are stored meshlet by meshlet.
+    struct Meshlet *meshlets;
+    int             num_meshlets;
+    uint32_t       *meshlet_vertices;
+
+    // How far (in model space) this level's surface strays from the full mesh, as estimated by
+    // the simplification (see model.c). Zero for the full mesh.
+    float error;
+};
+
+struct Model {
+    // Indexed mesh, with levels of detail from the full mesh (lods[0]) to the coarsest.
+    struct Vertex  *vertices;
+    int             num_vertices;
+    struct ModelLod lods[MODEL_MAX_LODS];
+    int             num_lods;
+
+    // Level of detail last drawn (see Model_select_lod).
+    int lod;
 
     // Texture maps.
     // int            map_width;
     // int            map_height;
     // unsigned char *map_kd;
 
+    // Bounds of the mesh in model space.
+    struct Vector3 aabb_min;
+    struct Vector3 aabb_max;
+    struct Vector3 sphere_center;
+    float          sphere_radius;
+
     // The mesh coordinates are local to the model.
     // (i.e., the center of the model is (0, 0, 0)).
     // The following is the model matrix, which
     // maps the mesh to world space.
     struct Matrix4 model_to_world;
+
+    // Set whenever model_to_world changes, until a scene holding the model refits its bounds.
+    int transform_changed;
+
+    // Set once an engine has reported the model's size and, if asked to, reordered its triangles,
+    // so drawing it again (such as along another camera path) doesn't do either again.
+    int loaded;
 };
 
 // We move Model instances by heap pointer.
 
-struct Model *Model_create(struct Tri *mesh, int num_tris, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz);
-struct Model *Model_from_obj(const char *file_name, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz);
+struct Model *Model_create(struct Vertex *vertices, int num_vertices, uint32_t *indices, int num_tris, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz);
+struct Model *Model_from_obj(const char *file_name, float x, float y, float z, float rx, float ry, float rz, float sx, float sy, float sz); // NULL if the file can't be read.
 void          Model_destroy(struct Model *m);
 
+// Simplifies the full mesh into coarser levels of detail, with triangle counts given by
+// MODEL_LOD_RATIOS. With a cache file, levels are read from it when it matches the mesh, and
+// written to it otherwise. Called by Model_from_obj, with the OBJ file name plus ".lod".
+void          Model_build_lods(struct Model *m, const char *cache_file_name);
+
+// Picks the coarsest level of detail whose error covers at most MODEL_LOD_ERROR_PIXELS on
+// screen, given the level drawn last and the pixels a unit of model space covers at the model's
+// distance. Switching to a coarser level needs a margin (MODEL_LOD_HYSTERESIS), so levels don't
+// flicker near a threshold.
+int           Model_select_lod(const struct Model *m, int lod, float pixels_per_unit);
+
+// Load-time triangle reordering (see model.c), for post-transform vertex cache locality within
+// meshlets and then for less overdraw. Both keep the meshlets intact.
+void          Model_optimize_vertex_cache(struct Model *m);
+void          Model_optimize_overdraw(struct Model *m);
+float         Model_acmr(const struct Model *m, int cache_size); // Average vertex cache misses per triangle (FIFO cache).
+
 inline void   Model_translate(struct Model *m, float delta_x, float delta_y, float delta_z);
 inline void   Model_rotate(struct Model *m, float delta_rx, float delta_ry, float delta_rz);
 inline void   Model_scale(struct Model *m, float delta_sx, float delta_sy, float delta_sz);
@@ -53,7 +53,39 @@ inline void split_slash(const char *line, char out[MAX_NSS][MAX_LSS], int *out_n
     *out_n = k;
 }
 
-inline struct Tri *parse_obj(const char *file_name, int *out_n) {
+// Open addressing hash table from (v, vt, vn) reference tuples to unique vertex indices.
+struct _VertexTable {
+    int *slots;    // Unique vertex index, or -1 if empty.
+    int *keys;     // (v, vt, vn) of each unique vertex, 3 per vertex.
+    int  capacity; // Power of two.
+};
+
+static inline unsigned int _hash_refs(int vref, int vtref, int vnref) {
+    unsigned int h = 2166136261u;
+    h = (h ^ (unsigned int)vref ) * 16777619u;
+    h = (h ^ (unsigned int)vtref) * 16777619u;
+    h = (h ^ (unsigned int)vnref) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+// Returns the slot of the tuple: either holding its vertex, or empty if it's new.
+static inline int _find_refs(const struct _VertexTable *table, int vref, int vtref, int vnref) {
+    int slot = _hash_refs(vref, vtref, vnref) & (table->capacity - 1);
+
+    while (table->slots[slot] != -1) {
+        const int *key = &table->keys[3 * table->slots[slot]];
+        if (key[0] == vref && key[1] == vtref && key[2] == vnref) break;
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    return slot;
+}
+
+inline int parse_obj(const char *file_name, struct Vertex **out_vertices, int *out_num_vertices, uint32_t **out_indices, int *out_num_tris) {
+    // Models are loaded on the main thread.
+    TRACE_BEGIN(parse_obj);
+    PERF_BEGIN(parse_obj);
+
     int nv  = 0; // Vertex.
     int nvt = 0; // Vertex texture.
     int nvn = 0; // Vertex normal.
@@ -67,6 +99,10 @@ inline struct Tri *parse_obj(const char *file_name, int *out_n) {
     char *keyword;
 
     FILE *fp = fopen(file_name, "r");
+    if (!fp) {
+        printf("parse_obj: Couldn't open %s.\n", file_name);
+        return -1;
+    }
 
     // Count vertex data and face elements.
     while (fgets(line, MAX_LL, fp)) {
@@ -86,8 +122,19 @@ inline struct Tri *parse_obj(const char *file_name, int *out_n) {
     struct Vector3 *vt = malloc(sizeof(struct Vector3) * nvt);
     struct Vector3 *vn = malloc(sizeof(struct Vector3) * nvn);
 
-    // Mesh to return.
-    struct Tri *f = malloc(sizeof(struct Tri) * nf);
+    // Mesh to return. Faces reference unique vertices by index, so vertices shared between
+    // faces are stored (and later transformed) once. There are at most 3 per face.
+    struct Vertex *vertices = malloc(sizeof(struct Vertex) * 3 * nf);
+    uint32_t      *indices  = malloc(sizeof(uint32_t) * 3 * nf);
+    int            num_vertices = 0;
+
+    // Unique (v, vt, vn) tuples seen so far, at a load factor of at most 1/2.
+    struct _VertexTable table;
+    table.capacity = 1;
+    while (table.capacity < 6 * nf) table.capacity *= 2;
+    table.slots = malloc(sizeof(int) * table.capacity);
+    table.keys  = malloc(sizeof(int) * 3 * 3 * nf);
+    memset(table.slots, -1, sizeof(int) * table.capacity);
 
     // Storage indeces.
     int vi  = 0; // Vertex.
@@ -95,7 +142,7 @@ inline struct Tri *parse_obj(const char *file_name, int *out_n) {
     int vni = 0; // Vertex normal.
     int fi  = 0; // Face (triangle).
 
-    // References.
+    // References (0 if absent).
     int vref;
     int vtref;
     int vnref;
@@ -133,37 +180,44 @@ inline struct Tri *parse_obj(const char *file_name, int *out_n) {
             };
         } else if (strcmp("f", keyword) == 0) {
             // Assume a triangular face (i.e. 3 vertices).
-            struct Tri tmpt;
-            struct Vertex tmpv;
             for (int i = 1; i < 4; ++i) {
                 split_slash(space_split_arr[i], slash_split_arr, &len_slash_split_arr);
             
-                vref = atoi(slash_split_arr[0]); // Required vertex reference.
-                tmpv.pos = v[vref - 1];
-                tmpv.col.x = rand() % 256;
-                tmpv.col.y = rand() % 256;
-                tmpv.col.z = rand() % 256;
+                vref  = atoi(slash_split_arr[0]); // Required vertex reference.
+                vtref = 0;
+                vnref = 0;
 
                 if (len_slash_split_arr >= 2 && strcmp("", slash_split_arr[1]) != 0) { // Optional texture coordinate reference.
                     vtref = atoi(slash_split_arr[1]);
-                    (void)vtref; // NO-OP.
-                    //tmpv.tex_u  = vt[vtref - 1].x;
-                    //tmpv.tex_v  = vt[vtref - 1].y;
                 } 
 
                 if (len_slash_split_arr == 3 && strcmp("", slash_split_arr[2]) != 0) { // Optional vertex normal reference.
                     vnref = atoi(slash_split_arr[2]);
-                    tmpv.norm = vn[vnref - 1];
                 }
 
-                switch (i) {
-                    case 1: tmpt.v0 = tmpv; break;
-                    case 2: tmpt.v1 = tmpv; break;
-                    case 3: tmpt.v2 = tmpv; break;
-                } 
+                int slot = _find_refs(&table, vref, vtref, vnref);
+
+                if (table.slots[slot] == -1) {
+                    struct Vertex tmpv;
+                    tmpv.pos   = v[vref - 1];
+                    tmpv.norm  = vnref ? vn[vnref - 1] : (struct Vector3){0, 0, 0, 0};
+                    tmpv.col.x = rand() % 256;
+                    tmpv.col.y = rand() % 256;
+                    tmpv.col.z = rand() % 256;
+                    //tmpv.tex_u  = vt[vtref - 1].x;
+                    //tmpv.tex_v  = vt[vtref - 1].y;
+
+                    table.slots[slot] = num_vertices;
+                    table.keys[3 * num_vertices + 0] = vref;
+                    table.keys[3 * num_vertices + 1] = vtref;
+                    table.keys[3 * num_vertices + 2] = vnref;
+                    vertices[num_vertices++] = tmpv;
+                }
+
+                indices[3 * fi + i - 1] = table.slots[slot];
             }
 
-            f[fi++] = tmpt;
+            ++fi;
         }
     }
 
@@ -171,9 +225,18 @@ inline struct Tri *parse_obj(const char *file_name, int *out_n) {
     free(v);
     free(vt);
     free(vn);
+    free(table.slots);
+    free(table.keys);
     
-    *out_n = nf;
-    return f;
+    *out_vertices     = realloc(vertices, sizeof(struct Vertex) * MAX(num_vertices, 1));
+    *out_num_vertices = num_vertices;
+    *out_indices      = indices;
+    *out_num_tris     = nf;
+
+    PERF_END(parse_obj, PERF_STAGE_PARSE_OBJ, nf);
+    TRACE_END(parse_obj, "parse_obj", 0);
+
+    return 0;
 }
 
 // inline void parse_mtl(const char *file_name, struct Obj_mtl *out, int *out_n) {
@@ -3,9 +3,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "vector3.h"
 #include "model.h"
+#include "util.h"
+#include "trace.h"
+#include "perf.h"
 
 // Some useful size constants.
 #define MAX_LL  512  // Max string length of a line in OBJ and MTL files.
@@ -22,7 +26,9 @@ struct Obj_mtl {
 inline void split_space(const char *line, char out[MAX_NSS][MAX_LSS], int *out_n);
 inline void split_slash(const char *line, char out[MAX_NSS][MAX_LSS], int *out_n);
 
-inline struct Tri *parse_obj(const char *file_name, int *out_n); // Outputs a heap allocated mesh.
+// Outputs a heap allocated indexed mesh: unique vertices, and 3 indices into them per triangle.
+// Returns 0, or -1 (leaving the outputs alone) if the file can't be opened.
+inline int  parse_obj(const char *file_name, struct Vertex **out_vertices, int *out_num_vertices, uint32_t **out_indices, int *out_num_tris);
 inline void parse_mtl(const char *file_name, struct Obj_mtl *out, int *out_n);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "overlay.h"
+#include "engine.h"
+
+#include <ctype.h>
+#include <string.h>
+
+// Glyph cells, in font pixels: 5 x 7 glyphs with a column and two rows of spacing.
+#define GLYPH_WIDTH  5
+#define GLYPH_HEIGHT 7
+#define CELL_WIDTH   6
+#define CELL_HEIGHT  9
+
+// Characters of the font, and their glyphs, one byte per row from the top. Bit 4 is the
+// leftmost pixel.
+static const char _font_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,:/%-()";
+
+static const unsigned char _font_glyphs[][GLYPH_HEIGHT] = {
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // A
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // B
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // C
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // D
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // E
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // F
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // G
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // H
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // L
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // O
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // P
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // Q
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // R
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // S
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // W
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // X
+    {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, // Y
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // Z
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // .
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ,
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // :
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // /
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // %
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // -
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // (
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // )
+};
+
+// Glyph of a character, or NULL for a space.
+static const unsigned char *_glyph(char c) {
+    const char *found = strchr(_font_chars, toupper((unsigned char)c));
+    if (c == '\0' || !found) {
+        return NULL;
+    }
+
+    return _font_glyphs[found - _font_chars];
+}
+
+// Fills a rectangle (clamped to the screen) with a colour.
+static void _fill(struct Engine *e, int x0, int y0, int x1, int y1, unsigned char r, unsigned char g, unsigned char b) {
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, e->window_width);
+    y1 = MIN(y1, e->window_height);
+
+    for (int y = y0; y < y1; ++y) {
+        unsigned char *color = &e->color_buffer[(e->color_pitch * y) + x0 * 4];
+        for (int x = x0; x < x1; ++x, color += 4) {
+            color[0] = r;
+            color[1] = g;
+            color[2] = b;
+            color[3] = 255;
+        }
+    }
+}
+
+void Overlay_draw_text(struct Engine *e, int x, int y, char lines[][OVERLAY_MAX_LINE], int num_lines) {
+    // Font pixels stay legible on large screens.
+    int scale = MAX(1, e->window_height / 540);
+
+    int columns = 0;
+    for (int i = 0; i < num_lines; ++i) {
+        columns = MAX(columns, (int)strlen(lines[i]));
+    }
+
+    int margin = 2 * scale;
+    int box_x0 = x;
+    int box_y0 = y;
+    int box_x1 = x + columns * CELL_WIDTH * scale + 2 * margin;
+    int box_y1 = y + num_lines * CELL_HEIGHT * scale + 2 * margin;
+
+    // A black box, with the glyphs white over it. The box is opaque because the colour buffer can
+    // be write-only texture memory (see _begin_frame), which can't be blended with.
+    _fill(e, box_x0, box_y0, box_x1, box_y1, 0, 0, 0);
+
+    for (int i = 0; i < num_lines; ++i) {
+        int line_y = box_y0 + margin + i * CELL_HEIGHT * scale;
+
+        for (int j = 0; lines[i][j]; ++j) {
+            const unsigned char *glyph = _glyph(lines[i][j]);
+            if (!glyph) {
+                continue;
+            }
+
+            int glyph_x = box_x0 + margin + j * CELL_WIDTH * scale;
+            for (int row = 0; row < GLYPH_HEIGHT; ++row) {
+                for (int col = 0; col < GLYPH_WIDTH; ++col) {
+                    if (glyph[row] & (1 << (GLYPH_WIDTH - 1 - col))) {
+                        int px = glyph_x + col * scale;
+                        int py = line_y + row * scale;
+                        _fill(e, px, py, px + scale, py + scale, 255, 255, 255);
+                    }
+                }
+            }
+        }
+    }
+
+    // The tiles under the box aren't clear anymore, so they have to be cleared before the next
+    // frame is drawn in them (see Raster_tile).
+    int tx0 = MAX(box_x0, 0) / TILE_SIZE;
+    int ty0 = MAX(box_y0, 0) / TILE_SIZE;
+    int tx1 = MIN((box_x1 - 1) / TILE_SIZE, e->num_tiles_x - 1);
+    int ty1 = MIN((box_y1 - 1) / TILE_SIZE, e->num_tiles_y - 1);
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            e->tiles[ty * e->num_tiles_x + tx].clear = 0;
+        }
+    }
+}
+
+void Overlay_draw_stats(struct Engine *e, const struct EngineStats *stats, float frame_ms) {
+    char lines[12][OVERLAY_MAX_LINE];
+    int  n = 0;
+
+    const int *frustum = stats->tris_frustum_culled;
+    int frustum_culled = 0;
+    for (int i = 0; i < 6; ++i) {
+        frustum_culled += frustum[i];
+    }
+
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "FRAME: %.2f MS (%d FPS)", frame_ms, frame_ms > 0 ? (int)(1000 / frame_ms) : 0);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "TRIANGLES SUBMITTED: %d", stats->tris_submitted);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  MODEL CULLED: %d", stats->tris_model_culled);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  MESHLET CULLED: %d", stats->tris_meshlet_culled);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  BACKFACE CULLED: %d", stats->tris_backface_culled);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  FRUSTUM CULLED: %d (L %d R %d T %d B %d N %d F %d)", frustum_culled,
+        frustum[ENGINE_CULL_LEFT], frustum[ENGINE_CULL_RIGHT], frustum[ENGINE_CULL_TOP],
+        frustum[ENGINE_CULL_BOTTOM], frustum[ENGINE_CULL_NEAR], frustum[ENGINE_CULL_FAR]);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  CLIPPED: %d (%d CLIPPED AWAY)", stats->tris_clipped, stats->tris_clipped_away);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  RASTERIZED: %d (%d HI-Z REJECTED)", stats->tris_rasterized, stats->tris_hiz_rejected);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "PIXELS TESTED: %d", stats->pixels_tested);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  PASSED: %d, SHADED: %d", stats->pixels_passed, stats->pixels_shaded);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  COVERED: %d, OVERDRAW: %.2f", stats->pixels_covered,
+        stats->pixels_covered ? (float)stats->pixels_passed / stats->pixels_covered : 0);
+    snprintf(lines[n++], OVERLAY_MAX_LINE, "  HI-Z REJECTED BLOCKS: %d", stats->hiz_rejected_blocks);
+
+    Overlay_draw_text(e, 0, 0, lines, n);
+}
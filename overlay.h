@@ -0,0 +1,26 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util.h"
+
+// Most characters on a line of the overlay.
+#define OVERLAY_MAX_LINE 96
+
+struct Engine;      // Forward declarations.
+struct EngineStats;
+
+// Text drawn over a frame with a built in 5 x 7 pixel font, scaled with the frame's height. The
+// font has digits, capital letters (lowercase letters are drawn as capitals), spaces and . , : / %
+// - ( ). Anything else is drawn as a space.
+
+// Draws the frame's statistics (see EngineStats) in the top left corner of the colour buffer.
+// Call after rasterizing the frame, before it is presented.
+void Overlay_draw_stats(struct Engine *e, const struct EngineStats *stats, float frame_ms);
+
+// Draws lines of text, on a black box, with their top left corner at (x, y).
+void Overlay_draw_text(struct Engine *e, int x, int y, char lines[][OVERLAY_MAX_LINE], int num_lines);
+
+#endif
@@ -0,0 +1,172 @@
+// For syscall.
+#define _GNU_SOURCE
+
+#include "perf.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// What a stage processed, and the counts added up over it.
+struct _PerfStage {
+    const char *name;
+    const char *unit;
+
+    uint64_t counts[PERF_NUM_COUNTERS];
+    uint64_t units;
+    int      calls;
+};
+
+static struct _PerfStage _stages[PERF_NUM_STAGES] = {
+    {.name = "input",     .unit = "frame"},
+    {.name = "camera",    .unit = "frame"},
+    {.name = "geometry",  .unit = "triangle"},
+    {.name = "clear",     .unit = "frame"},
+    {.name = "raster",    .unit = "pixel"},
+    {.name = "upload",    .unit = "pixel"},
+    {.name = "present",   .unit = "frame"},
+    {.name = "parse_obj", .unit = "triangle"},
+};
+
+static const char *_counter_names[PERF_NUM_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "L1D misses",
+    "LLC misses",
+    "branch misses",
+};
+
+// Counter file descriptors, -1 for counters that aren't open.
+static int _fds[PERF_NUM_COUNTERS] = {-1, -1, -1, -1, -1};
+static int _open = 0;
+
+#ifdef __linux__
+static int _open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.inherit        = 1; // Count threads created later, such as the thread pool's.
+    attr.exclude_kernel = 1; // Allowed without privileges (up to perf_event_paranoid 2).
+    attr.exclude_hv     = 1;
+
+    // This thread (and its children), on any CPU.
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+int Perf_open(void) {
+#ifdef __linux__
+    uint64_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    _fds[PERF_CYCLES]        = _open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    _fds[PERF_INSTRUCTIONS]  = _open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    _fds[PERF_L1D_MISSES]    = _open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_read_miss);
+    _fds[PERF_LLC_MISSES]    = _open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL  | cache_read_miss);
+    _fds[PERF_BRANCH_MISSES] = _open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (_fds[i] < 0) {
+            printf("Perf_open: Couldn't open the %s counter.\n", _counter_names[i]);
+        } else {
+            _open = 1;
+        }
+    }
+    if (!_open) {
+        printf("Perf_open: No hardware counters (check /proc/sys/kernel/perf_event_paranoid).\n");
+        return -1;
+    }
+
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (_fds[i] >= 0) ioctl(_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return 0;
+#else
+    printf("Perf_open: Performance counters are only supported on Linux.\n");
+    return -1;
+#endif
+}
+
+void Perf_close(void) {
+#ifdef __linux__
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (_fds[i] >= 0) close(_fds[i]);
+        _fds[i] = -1;
+    }
+#endif
+    _open = 0;
+}
+
+struct PerfSample Perf_sample(void) {
+    struct PerfSample s = {{0}};
+    if (!_open) {
+        return s;
+    }
+
+#ifdef __linux__
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        // Value, time enabled and time running.
+        uint64_t values[3];
+        if (_fds[i] < 0 || read(_fds[i], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+            continue;
+        }
+
+        // Scale up for the time the counter shared the hardware with others.
+        s.counts[i] = values[2] < values[1] ? (uint64_t)((double)values[0] * values[1] / values[2]) : values[0];
+    }
+#endif
+    return s;
+}
+
+void Perf_end(int stage, const struct PerfSample *begin, uint64_t units) {
+    if (!_open) {
+        return;
+    }
+
+    struct PerfSample end = Perf_sample();
+    struct _PerfStage *st = &_stages[stage];
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        // Scaled counts can step back a little.
+        st->counts[i] += end.counts[i] > begin->counts[i] ? end.counts[i] - begin->counts[i] : 0;
+    }
+    st->units += units;
+    st->calls += 1;
+}
+
+void Perf_add_units(int stage, uint64_t units) {
+    if (_open) {
+        _stages[stage].units += units;
+    }
+}
+
+void Perf_report(void) {
+    if (!_open) {
+        return;
+    }
+
+    printf("Perf_report: %-10s %8s %14s %6s %16s %16s %16s\n", "stage", "calls", "cycles/call", "IPC", "L1D misses/unit", "LLC misses/unit", "br misses/unit");
+    for (int s = 0; s < PERF_NUM_STAGES; ++s) {
+        struct _PerfStage *st = &_stages[s];
+        if (st->calls == 0) {
+            continue;
+        }
+
+        const uint64_t *c = st->counts;
+        double units = (double)MAX(st->units, 1);
+        printf("Perf_report: %-10s %8d %14.0f %6.2f %16.4f %16.4f %16.4f (per %s)\n",
+            st->name, st->calls, (double)c[PERF_CYCLES] / st->calls,
+            c[PERF_CYCLES] ? (double)c[PERF_INSTRUCTIONS] / c[PERF_CYCLES] : 0,
+            c[PERF_L1D_MISSES] / units, c[PERF_LLC_MISSES] / units, c[PERF_BRANCH_MISSES] / units, st->unit);
+
+        memset(st->counts, 0, sizeof(st->counts));
+        st->units = 0;
+        st->calls = 0;
+    }
+}
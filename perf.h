@@ -0,0 +1,70 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Hardware counters, read through Linux's perf_event_open.
+#define PERF_CYCLES        0
+#define PERF_INSTRUCTIONS  1
+#define PERF_L1D_MISSES    2 // Level 1 data cache read misses.
+#define PERF_LLC_MISSES    3 // Last level cache read misses.
+#define PERF_BRANCH_MISSES 4
+#define PERF_NUM_COUNTERS  5
+
+// Stages counters are attributed to. Each is reported per frame, triangle or pixel.
+#define PERF_STAGE_INPUT     0
+#define PERF_STAGE_CAMERA    1
+#define PERF_STAGE_GEOMETRY  2 // Culling, vertex transforms, clipping and binning, per triangle submitted.
+#define PERF_STAGE_CLEAR     3
+#define PERF_STAGE_RASTER    4 // Per pixel depth tested.
+#define PERF_STAGE_UPLOAD    5 // Per pixel of the frame.
+#define PERF_STAGE_PRESENT   6
+#define PERF_STAGE_PARSE_OBJ 7 // Per triangle loaded.
+#define PERF_NUM_STAGES      8
+
+// Counts measured by the counters over a stretch of time, scaled up for the time a counter wasn't
+// running if the kernel had to share the hardware between counters.
+struct PerfSample {
+    uint64_t counts[PERF_NUM_COUNTERS];
+};
+
+// Performance counters attributed to pipeline stages, to tell whether a stage is bound by compute
+// (high IPC) or memory (cache misses). Optional, and Linux only: nothing is counted until
+// Perf_open succeeds, and until then, samples cost a branch.
+//
+// The counters count every thread of the process, including threads created after Perf_open (so
+// open them before the engine's thread pool). Stages are therefore measured from the main thread,
+// and include whatever workers do meanwhile, such as rasterizing. With frames in flight, the
+// previous frame is uploaded and presented while the workers rasterize, so the raster stage
+// includes those too (see --frames-in-flight).
+//
+//     PERF_BEGIN(raster);
+//     ...
+//     PERF_END(raster, PERF_STAGE_RASTER, pixels);
+
+#define PERF_BEGIN(span)             struct PerfSample _perf_##span = Perf_sample()
+#define PERF_END(span, stage, units) Perf_end((stage), &_perf_##span, (units))
+
+// Opens the counters, for the calling thread and threads it creates later. Returns 0 if any of
+// them could be opened, or -1 (on other systems, without permission or without hardware counters).
+int               Perf_open(void);
+void              Perf_close(void);
+
+// Current counts (zeros unless the counters are open).
+struct PerfSample Perf_sample(void);
+
+// Adds the counts since a sample to a stage, along with what it processed (frames, triangles or
+// pixels, see PERF_STAGE_*).
+void              Perf_end(int stage, const struct PerfSample *begin, uint64_t units);
+
+// Adds to what a stage processed, for when that's only known after it ended.
+void              Perf_add_units(int stage, uint64_t units);
+
+// Prints each stage's IPC and misses per unit so far, then resets them.
+void              Perf_report(void);
+
+#endif
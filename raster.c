@@ -0,0 +1,1263 @@
+#include "raster.h"
+#include "engine.h"
+
+// Depth buffer access, in the format's units (see Raster_set_depth_format).
+
+static inline int _depth_integer(const struct Engine *e) {
+    return e->depth_format == RASTER_DEPTH_UNORM16 || e->depth_format == RASTER_DEPTH_UNORM24;
+}
+
+// Most a depth changes when it's stored.
+static inline float _depth_rounding(const struct Engine *e) {
+    return _depth_integer(e) ? 0.5f : 0;
+}
+
+// A depth as the format stores it: integer formats round to the nearest unit within their range.
+static inline float _depth_round(const struct Engine *e, float z) {
+    return _depth_integer(e) ? nearbyintf(MIN(MAX(z, 0), e->depth_far)) : z;
+}
+
+static inline float _depth_load(const struct Engine *e, int i) {
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: return ((const uint16_t *)e->depth_buffer)[i];
+        case RASTER_DEPTH_UNORM24: return ((const uint32_t *)e->depth_buffer)[i];
+        default:                   return ((const float *)e->depth_buffer)[i];
+    }
+}
+
+static inline void _depth_store(struct Engine *e, int i, float z) {
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: ((uint16_t *)e->depth_buffer)[i] = z; break;
+        case RASTER_DEPTH_UNORM24: ((uint32_t *)e->depth_buffer)[i] = z; break;
+        default:                   ((float *)e->depth_buffer)[i]    = z; break;
+    }
+}
+
+// Clears n depths from i to the farthest value.
+static void _depth_clear(struct Engine *e, int i, int n) {
+    for (int k = i; k < i + n; ++k) {
+        _depth_store(e, k, e->depth_far);
+    }
+}
+
+void Raster_create_tiles(struct Engine *e) {
+    e->num_tiles_x = (e->window_width  + TILE_SIZE - 1) / TILE_SIZE;
+    e->num_tiles_y = (e->window_height + TILE_SIZE - 1) / TILE_SIZE;
+    e->num_tiles   = e->num_tiles_x * e->num_tiles_y;
+    e->tiles       = malloc(sizeof(struct Tile) * e->num_tiles);
+
+    for (int ty = 0; ty < e->num_tiles_y; ++ty) {
+        for (int tx = 0; tx < e->num_tiles_x; ++tx) {
+            struct Tile *t = &e->tiles[ty * e->num_tiles_x + tx];
+
+            // Tiles on the right and bottom edges may be partial.
+            t->x0 = tx * TILE_SIZE;
+            t->y0 = ty * TILE_SIZE;
+            t->x1 = MIN(t->x0 + TILE_SIZE, e->window_width);
+            t->y1 = MIN(t->y0 + TILE_SIZE, e->window_height);
+
+            t->hiz_rejected_blocks = 0;
+            t->hiz_rejected_tris   = 0;
+            t->pixels_tested       = 0;
+            t->pixels_written      = 0;
+            t->pixels_shaded       = 0;
+            t->pixels_covered      = 0;
+
+            t->clear = 0;
+
+            t->capacity = 64;
+            t->num_tris = 0;
+            t->tris     = malloc(sizeof(int) * t->capacity);
+        }
+    }
+
+    e->hiz_width  = (e->window_width  + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    e->hiz_height = (e->window_height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    e->hiz_buffer = malloc(sizeof(float) * e->hiz_width * e->hiz_height);
+    e->hiz_dirty  = malloc(sizeof(unsigned char) * e->hiz_width * e->hiz_height);
+
+    e->raster_order_capacity = 0;
+    e->raster_order          = NULL;
+    e->raster_order_tmp      = NULL;
+    e->raster_sort_keys      = NULL;
+}
+
+void Raster_destroy_tiles(struct Engine *e) {
+    for (int i = 0; i < e->num_tiles; ++i) {
+        free(e->tiles[i].tris);
+    }
+    free(e->tiles);
+    free(e->hiz_buffer);
+    free(e->hiz_dirty);
+    free(e->raster_order);
+    free(e->raster_order_tmp);
+    free(e->raster_sort_keys);
+}
+
+static inline int32_t _to_fixed(float v) {
+    // Clamp first so the conversion is defined for vertices far outside the screen (and NaN).
+    v = MAX(-RASTER_MAX_COORD, MIN(v, RASTER_MAX_COORD));
+    return (int32_t)lrintf(v * SUBPIXEL_SCALE);
+}
+
+// Top-left fill rule: pixel centers exactly on an edge belong to the triangle only if the edge
+// is a left edge (interior to its right, a > 0) or a top edge (horizontal, interior below, b > 0).
+// Two triangles sharing an edge traverse it in opposite directions, so exactly one of them owns
+// the center. Other edges get a bias of -1, which turns E >= 0 into E > 0.
+static inline int _fill_bias(int32_t a, int32_t b) {
+    return (a > 0 || (a == 0 && b > 0)) ? 0 : -1;
+}
+
+inline void Raster_setup_tri(struct Engine *e, struct RasterTri *rt) {
+    int32_t x0 = _to_fixed(rt->v0.x);
+    int32_t y0 = _to_fixed(rt->v0.y);
+    int32_t x1 = _to_fixed(rt->v1.x);
+    int32_t y1 = _to_fixed(rt->v1.y);
+    int32_t x2 = _to_fixed(rt->v2.x);
+    int32_t y2 = _to_fixed(rt->v2.y);
+
+    // Edge functions, with the same orientation as the old floating point _edge(): the
+    // edge opposite v0 runs from v1 to v2, and so on.
+    rt->a0 = y2 - y1;
+    rt->b0 = x1 - x2;
+    rt->c0 = (int64_t)x2 * y1 - (int64_t)x1 * y2 + _fill_bias(rt->a0, rt->b0);
+
+    rt->a1 = y0 - y2;
+    rt->b1 = x2 - x0;
+    rt->c1 = (int64_t)x0 * y2 - (int64_t)x2 * y0 + _fill_bias(rt->a1, rt->b1);
+
+    rt->a2 = y1 - y0;
+    rt->b2 = x0 - x1;
+    rt->c2 = (int64_t)x1 * y0 - (int64_t)x0 * y1 + _fill_bias(rt->a2, rt->b2);
+
+    // Only triangles with a positive area are filled. This rejects degenerate triangles, which
+    // would otherwise produce NaN barycentrics.
+    int64_t area = (int64_t)(x2 - x0) * (y1 - y0) - (int64_t)(y2 - y0) * (x1 - x0);
+
+    rt->fill     = 0;
+    rt->area_inv = area > 0 ? 1.0 / area : 0;
+
+    // Conservative nearest depth. The fill rule bias lowers each edge function by up to 1, so the
+    // barycentrics can each be up to area_inv below their true value (and the interpolated depth
+    // below the smallest vertex depth). Depths are non-negative since triangles crossing the near
+    // plane are clipped, except for reversed Z (whose depths are negated). Integer formats round
+    // depths to the nearest unit.
+    float z_bias = (fabsf(rt->v0.z) + fabsf(rt->v1.z) + fabsf(rt->v2.z)) * rt->area_inv;
+    float z_min  = MIN(MIN(rt->v0.z, rt->v1.z), rt->v2.z) - z_bias;
+    z_min -= fabsf(z_min) * HIZ_EPSILON;
+    if (e->depth_format != RASTER_DEPTH_REVERSED) {
+        z_min = MAX(0, z_min);
+    }
+    rt->z_min = z_min - _depth_rounding(e);
+
+    // Bounds of the pixel centers (16x + 8 in fixed point) inside the triangle's bounding box.
+    int32_t bb_min_x = MAX(MIN(MIN(x0, x1), x2), 0);
+    int32_t bb_max_x = MAX(MAX(x0, x1), x2);
+    int32_t bb_min_y = MAX(MIN(MIN(y0, y1), y2), 0);
+    int32_t bb_max_y = MAX(MAX(y0, y1), y2);
+
+    if (area <= 0 || bb_max_x < SUBPIXEL_SCALE / 2 || bb_max_y < SUBPIXEL_SCALE / 2) {
+        return;
+    }
+
+    rt->min_x = (bb_min_x + SUBPIXEL_SCALE / 2 - 1) >> SUBPIXEL_BITS;
+    rt->min_y = (bb_min_y + SUBPIXEL_SCALE / 2 - 1) >> SUBPIXEL_BITS;
+    rt->max_x = MIN((bb_max_x - SUBPIXEL_SCALE / 2) >> SUBPIXEL_BITS, e->window_width  - 1);
+    rt->max_y = MIN((bb_max_y - SUBPIXEL_SCALE / 2) >> SUBPIXEL_BITS, e->window_height - 1);
+
+    rt->fill = rt->min_x <= rt->max_x && rt->min_y <= rt->max_y;
+}
+
+// Sort keys are the top SORT_KEY_BITS bits of the nearest vertex depth's float representation,
+// which orders like the depth itself (depths are non-negative, once reversed Z's are offset from
+// [-1, 0)) with finer buckets closer to 0.
+#define SORT_KEY_BITS   22
+#define SORT_RADIX_BITS 11
+#define SORT_RADIX      (1 << SORT_RADIX_BITS)
+
+static inline uint32_t _sort_key(const struct Engine *e, const struct RasterTri *rt) {
+    union { float f; uint32_t u; } z;
+    z.f = MIN(MIN(rt->v0.z, rt->v1.z), rt->v2.z);
+    if (e->depth_format == RASTER_DEPTH_REVERSED) {
+        z.f += 1;
+    }
+    z.f = MAX(0, z.f);
+    return z.u >> (32 - SORT_KEY_BITS);
+}
+
+void Raster_sort_tris(struct Engine *e) {
+    int n = e->num_raster_tris;
+
+    if (e->raster_order_capacity < n) {
+        e->raster_order_capacity = e->raster_tris_capacity;
+        e->raster_order     = realloc(e->raster_order,     sizeof(int)      * e->raster_order_capacity);
+        e->raster_order_tmp = realloc(e->raster_order_tmp, sizeof(int)      * e->raster_order_capacity);
+        e->raster_sort_keys = realloc(e->raster_sort_keys, sizeof(uint32_t) * e->raster_order_capacity);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        e->raster_order[i]     = i;
+        e->raster_sort_keys[i] = _sort_key(e, &e->raster_tris[i]);
+    }
+
+    // LSD radix sort of the indices, one pass per SORT_RADIX_BITS digit. Each pass is stable, so
+    // triangles with equal keys stay in submission order.
+    int count[SORT_RADIX];
+    for (int shift = 0; shift < SORT_KEY_BITS; shift += SORT_RADIX_BITS) {
+        memset(count, 0, sizeof(count));
+        for (int i = 0; i < n; ++i) {
+            ++count[(e->raster_sort_keys[i] >> shift) & (SORT_RADIX - 1)];
+        }
+
+        int sum = 0;
+        for (int d = 0; d < SORT_RADIX; ++d) {
+            int c = count[d];
+            count[d] = sum;
+            sum += c;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int tri = e->raster_order[i];
+            e->raster_order_tmp[count[(e->raster_sort_keys[tri] >> shift) & (SORT_RADIX - 1)]++] = tri;
+        }
+
+        int *tmp = e->raster_order;
+        e->raster_order     = e->raster_order_tmp;
+        e->raster_order_tmp = tmp;
+    }
+}
+
+// Expands [min, max] by the pixels a line from a to b can touch. Bresenham truncates its float
+// endpoints to ints, so we clamp before truncating to stay in int range.
+static inline void _line_bounds(struct Engine *e, struct Vector3 a, struct Vector3 b, int *min_x, int *min_y, int *max_x, int *max_y) {
+    int ax = MAX(-1, MIN(a.x, e->window_width));
+    int ay = MAX(-1, MIN(a.y, e->window_height));
+    int bx = MAX(-1, MIN(b.x, e->window_width));
+    int by = MAX(-1, MIN(b.y, e->window_height));
+
+    *min_x = MIN(*min_x, MIN(ax, bx));
+    *min_y = MIN(*min_y, MIN(ay, by));
+    *max_x = MAX(*max_x, MAX(ax, bx));
+    *max_y = MAX(*max_y, MAX(ay, by));
+}
+
+inline void Raster_bin_tri(struct Engine *e, int tri_index) {
+    const struct RasterTri *rt = &e->raster_tris[tri_index];
+
+    // Inclusive pixel bounds of everything this triangle draws.
+    int min_x = e->window_width;
+    int min_y = e->window_height;
+    int max_x = -1;
+    int max_y = -1;
+
+    if (e->show_vertex_normals) {
+        _line_bounds(e, rt->v0, rt->vn0, &min_x, &min_y, &max_x, &max_y);
+        _line_bounds(e, rt->v1, rt->vn1, &min_x, &min_y, &max_x, &max_y);
+        _line_bounds(e, rt->v2, rt->vn2, &min_x, &min_y, &max_x, &max_y);
+    }
+
+    if (e->wireframe) {
+        _line_bounds(e, rt->v0, rt->v1, &min_x, &min_y, &max_x, &max_y);
+        _line_bounds(e, rt->v1, rt->v2, &min_x, &min_y, &max_x, &max_y);
+    } else if (rt->fill) {
+        min_x = MIN(min_x, rt->min_x);
+        min_y = MIN(min_y, rt->min_y);
+        max_x = MAX(max_x, rt->max_x);
+        max_y = MAX(max_y, rt->max_y);
+    }
+
+    min_x = MAX(min_x, 0);
+    min_y = MAX(min_y, 0);
+    max_x = MIN(max_x, e->window_width  - 1);
+    max_y = MIN(max_y, e->window_height - 1);
+
+    if (min_x > max_x || min_y > max_y) {
+        return;
+    }
+
+    for (int ty = min_y / TILE_SIZE; ty <= max_y / TILE_SIZE; ++ty) {
+        for (int tx = min_x / TILE_SIZE; tx <= max_x / TILE_SIZE; ++tx) {
+            struct Tile *t = &e->tiles[ty * e->num_tiles_x + tx];
+
+            if (t->num_tris == t->capacity) {
+                t->capacity *= 2;
+                t->tris = realloc(t->tris, sizeof(int) * t->capacity);
+            }
+            t->tris[t->num_tris++] = tri_index;
+        }
+    }
+}
+
+// Truncates a line endpoint to a pixel, like Engine_bresenham does. Clamped first so the
+// conversion is defined for endpoints far outside the screen (such as normal tips divided by a w
+// near 0), and NaN.
+static inline int _line_coord(float v) {
+    return (int)MAX(-RASTER_MAX_COORD, MIN(v, RASTER_MAX_COORD));
+}
+
+// Engine_bresenham, but only the pixels inside the tile are written. Lines can be far longer
+// than a tile (with vertices out in the guard band), so the line is clipped to the tile first, and
+// only the steps inside it are taken.
+static inline void _line(struct Engine *e, const struct Tile *t, float fx1, float fy1, float fx2, float fy2, int r, int g, int b) {
+    int x1 = _line_coord(fx1);
+    int y1 = _line_coord(fy1);
+    int x2 = _line_coord(fx2);
+    int y2 = _line_coord(fy2);
+
+    int steep = abs(y2 - y1) > abs(x2 - x1);
+    int inc = -1;
+    int tmp;
+
+    // Tile bounds along the major (stepped) and minor axes, inclusive.
+    int major_lo = steep ? t->y0 : t->x0;
+    int major_hi = steep ? t->y1 - 1 : t->x1 - 1;
+    int minor_lo = steep ? t->x0 : t->y0;
+    int minor_hi = steep ? t->x1 - 1 : t->y1 - 1;
+
+    if (steep) {
+        tmp = x1;
+        x1 = y1;
+        y1 = tmp;
+
+        tmp = x2;
+        x2 = y2;
+        y2 = tmp;
+    }
+
+    if (x1 > x2) {
+        tmp = x1;
+        x1 = x2;
+        x2 = tmp;
+
+        tmp = y1;
+        y1 = y2;
+        y2 = tmp;
+    }
+
+    if (y1 < y2) {
+        inc = 1;
+    }
+
+    int64_t dx = abs(x2 - x1);
+    int64_t dy = abs(y2 - y1);
+
+    // After k steps, y has moved by m(k) = floor((2 * k * dy + dx) / (2 * dx)), which is never more
+    // than k. Clip the steps to the tile along the major axis, then to the steps where m keeps y
+    // within the tile.
+    int64_t k_min = MAX(0, (int64_t)major_lo - x1);
+    int64_t k_max = MIN(dx, (int64_t)major_hi - x1);
+
+    int64_t m_lo = inc > 0 ? (int64_t)minor_lo - y1 : (int64_t)y1 - minor_hi;
+    int64_t m_hi = inc > 0 ? (int64_t)minor_hi - y1 : (int64_t)y1 - minor_lo;
+    if (m_hi < 0 || (dy == 0 && m_lo > 0)) {
+        return;
+    }
+    if (dy > 0) {
+        if (m_lo > 0) {
+            k_min = MAX(k_min, ((2 * m_lo - 1) * dx + 2 * dy - 1) / (2 * dy));
+        }
+        k_max = MIN(k_max, ((2 * m_hi + 1) * dx - 1) / (2 * dy));
+    }
+    if (k_min > k_max) {
+        return;
+    }
+
+    int64_t m  = dx ? (2 * k_min * dy + dx) / (2 * dx) : 0;
+    int     x  = x1 + k_min;
+    int     y  = y1 + inc * m;
+    int     e_ = k_min * dy - m * dx;
+
+    while (x <= x1 + k_max) {
+        if (steep) {
+            Engine_set_pixel(e, y, x, r, g, b);
+        } else {
+            Engine_set_pixel(e, x, y, r, g, b);
+        }
+
+        if ((e_ + dy) << 1 < dx) {
+            e_ = e_ + dy;
+        } else {
+            y += inc;
+            e_ = e_ + dy - dx;
+        }
+        ++x;
+    }
+}
+
+// Shades one pixel of the triangle given its barycentric coordinates. This is something like a
+// fragment shader.
+static inline void _shade(struct Engine *e, const struct RasterTri *rt, int x, int y, float w0, float w1, float w2) {
+    // Interpolate normal.
+    float nx = rt->n0.x * w0 + rt->n1.x * w1 + rt->n2.x * w2;
+    float ny = rt->n0.y * w0 + rt->n1.y * w1 + rt->n2.y * w2;
+    float nz = rt->n0.z * w0 + rt->n1.z * w1 + rt->n2.z * w2;
+
+    // Same as Engine_set_pixel, but inlined into the kernels.
+    unsigned char *color = &e->color_buffer[(e->color_pitch * y) + x * 4];
+    color[0] = (int)(nx * 255);
+    color[1] = (int)(ny * 255);
+    color[2] = (int)(nz * 255);
+    color[3] = 255;
+}
+
+// Processes one pixel whose center is covered: depth test, then shading (or, in deferred mode,
+// recording the triangle in the visibility buffer). e0, e1 and e2 are the edge functions at
+// the pixel center.
+static inline void _pixel(struct Engine *e, struct Tile *t, const struct RasterTri *rt, int x, int y, int64_t e0, int64_t e1, int64_t e2) {
+    // Barycentric coordinates.
+    float w0 = e0 * rt->area_inv;
+    float w1 = e1 * rt->area_inv;
+    float w2 = e2 * rt->area_inv;
+
+    // Interpolate depth.
+    float z = _depth_round(e, rt->v0.z * w0 + rt->v1.z * w1 + rt->v2.z * w2);
+
+    int   i = (e->window_width * y) + x;
+    float buffer_depth = _depth_load(e, i);
+
+    // Depth test (against the farthest value where nothing was drawn yet).
+    t->pixels_tested += 1;
+    if (z < buffer_depth) {
+        t->pixels_written += 1;
+        t->pixels_covered += buffer_depth == e->depth_far;
+
+        if (e->deferred) {
+            e->vis_buffer[(e->window_width * y) + x] = rt - e->raster_tris;
+        } else {
+            _shade(e, rt, x, y, w0, w1, w2);
+        }
+        _depth_store(e, i, z);
+    }
+}
+
+// Edge functions of a triangle at a pixel center, and their increments per pixel and per row.
+struct _Edges {
+    int64_t e0, e1, e2;
+    int64_t step_x0, step_x1, step_x2;
+    int64_t step_y0, step_y1, step_y2;
+};
+
+static inline void _edges_at(const struct RasterTri *rt, int x, int y, struct _Edges *out) {
+    int64_t px = ((int64_t)x << SUBPIXEL_BITS) + SUBPIXEL_SCALE / 2;
+    int64_t py = ((int64_t)y << SUBPIXEL_BITS) + SUBPIXEL_SCALE / 2;
+
+    out->e0 = rt->a0 * px + rt->b0 * py + rt->c0;
+    out->e1 = rt->a1 * px + rt->b1 * py + rt->c1;
+    out->e2 = rt->a2 * px + rt->b2 * py + rt->c2;
+
+    out->step_x0 = (int64_t)rt->a0 * SUBPIXEL_SCALE;
+    out->step_x1 = (int64_t)rt->a1 * SUBPIXEL_SCALE;
+    out->step_x2 = (int64_t)rt->a2 * SUBPIXEL_SCALE;
+    out->step_y0 = (int64_t)rt->b0 * SUBPIXEL_SCALE;
+    out->step_y1 = (int64_t)rt->b1 * SUBPIXEL_SCALE;
+    out->step_y2 = (int64_t)rt->b2 * SUBPIXEL_SCALE;
+}
+
+// Scalar reference kernel. Fills the pixels of [min_x, max_x] x [min_y, max_y] covered by the triangle.
+// If full is set, the caller guarantees every pixel is covered and the coverage test is skipped.
+static void _fill_scalar(struct Engine *e, struct Tile *t, const struct RasterTri *rt, int min_x, int min_y, int max_x, int max_y, int full) {
+    struct _Edges ed;
+    _edges_at(rt, min_x, min_y, &ed);
+
+    int64_t row_w0 = ed.e0;
+    int64_t row_w1 = ed.e1;
+    int64_t row_w2 = ed.e2;
+
+    for (int y = min_y; y <= max_y; ++y) {
+        int64_t e0 = row_w0;
+        int64_t e1 = row_w1;
+        int64_t e2 = row_w2;
+
+        for (int x = min_x; x <= max_x; ++x) {
+            // Inside iff no edge function is negative (i.e. no sign bit is set).
+            if (full || (e0 | e1 | e2) >= 0) {
+                _pixel(e, t, rt, x, y, e0, e1, e2);
+            }
+
+            e0 += ed.step_x0;
+            e1 += ed.step_x1;
+            e2 += ed.step_x2;
+        }
+
+        row_w0 += ed.step_y0;
+        row_w1 += ed.step_y1;
+        row_w2 += ed.step_y2;
+    }
+}
+
+// The SIMD kernels process aligned blocks of N x 1 pixels. They evaluate the edge functions in 32 bit
+// lanes, which is exact whenever a block's edge values fit in 32 bits (everything but huge triangles).
+// Blocks that don't fit, or that would cross the tile's right edge, go through _pixel instead.
+// Every lane does exactly the float operations _pixel does, so the kernels are bit-identical
+// to the scalar reference.
+
+static inline int _fits_int32(int64_t first, int64_t step, int n) {
+    int64_t last = first + step * (n - 1);
+    return first >= INT32_MIN && first <= INT32_MAX && last >= INT32_MIN && last <= INT32_MAX
+        && step * (n - 1) >= INT32_MIN && step * (n - 1) <= INT32_MAX;
+}
+
+// Scalar fallback for the pixels [x0, x1] of a block starting at edge values e0, e1, e2 (at x0).
+static inline void _block_scalar(struct Engine *e, struct Tile *t, const struct RasterTri *rt, const struct _Edges *ed, int x0, int x1, int y, int64_t e0, int64_t e1, int64_t e2, int full) {
+    for (int x = x0; x <= x1; ++x) {
+        if (full || (e0 | e1 | e2) >= 0) {
+            _pixel(e, t, rt, x, y, e0, e1, e2);
+        }
+        e0 += ed->step_x0;
+        e1 += ed->step_x1;
+        e2 += ed->step_x2;
+    }
+}
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+// Depth buffer access for the 4 pixels from i (see _depth_load). Stores write the lanes of z
+// that pass, and the old depths elsewhere.
+
+static inline __m128 _depth_round_sse2(const struct Engine *e, __m128 z) {
+    if (!_depth_integer(e)) {
+        return z;
+    }
+    z = _mm_min_ps(_mm_max_ps(z, _mm_setzero_ps()), _mm_set1_ps(e->depth_far));
+    return _mm_cvtepi32_ps(_mm_cvtps_epi32(z));
+}
+
+static inline __m128 _depth_load_sse2(const struct Engine *e, int i) {
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)&((const uint16_t *)e->depth_buffer)[i]), _mm_setzero_si128()));
+        case RASTER_DEPTH_UNORM24: return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&((const uint32_t *)e->depth_buffer)[i]));
+        default:                   return _mm_loadu_ps(&((const float *)e->depth_buffer)[i]);
+    }
+}
+
+static inline void _depth_store_sse2(struct Engine *e, int i, __m128i pass, __m128 z, __m128 old) {
+    __m128 passf = _mm_castsi128_ps(pass);
+    __m128 depth = _mm_or_ps(_mm_and_ps(passf, z), _mm_andnot_ps(passf, old));
+
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: {
+            // SSE2 only packs to signed 16 bits, so pack around the middle of the range.
+            __m128i d = _mm_sub_epi32(_mm_cvtps_epi32(depth), _mm_set1_epi32(0x8000));
+            d = _mm_xor_si128(_mm_packs_epi32(d, d), _mm_set1_epi16((short)0x8000));
+            _mm_storel_epi64((__m128i *)&((uint16_t *)e->depth_buffer)[i], d);
+            break;
+        }
+        case RASTER_DEPTH_UNORM24: _mm_storeu_si128((__m128i *)&((uint32_t *)e->depth_buffer)[i], _mm_cvtps_epi32(depth)); break;
+        default:                   _mm_storeu_ps(&((float *)e->depth_buffer)[i], depth); break;
+    }
+}
+
+static void _fill_sse2(struct Engine *e, struct Tile *t, const struct RasterTri *rt, int min_x, int min_y, int max_x, int max_y, int full) {
+    int bx0 = min_x & ~3;
+
+    struct _Edges ed;
+    _edges_at(rt, bx0, min_y, &ed);
+
+    int use_simd = _fits_int32(0, ed.step_x0, 4) && _fits_int32(0, ed.step_x1, 4) && _fits_int32(0, ed.step_x2, 4);
+
+    __m128i lane   = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i off0   = _mm_setr_epi32(0, ed.step_x0, 2 * ed.step_x0, 3 * ed.step_x0);
+    __m128i off1   = _mm_setr_epi32(0, ed.step_x1, 2 * ed.step_x1, 3 * ed.step_x1);
+    __m128i off2   = _mm_setr_epi32(0, ed.step_x2, 2 * ed.step_x2, 3 * ed.step_x2);
+    __m128i lo     = _mm_set1_epi32(min_x - 1);
+    __m128i hi     = _mm_set1_epi32(max_x + 1);
+    __m128i alpha  = _mm_set1_epi32(0xFF000000);
+    __m128i byte   = _mm_set1_epi32(0xFF);
+
+    __m128  area_inv = _mm_set1_ps(rt->area_inv);
+    __m128  z1  = _mm_set1_ps(rt->v0.z);
+    __m128  z2  = _mm_set1_ps(rt->v1.z);
+    __m128  z3  = _mm_set1_ps(rt->v2.z);
+    __m128  n0x = _mm_set1_ps(rt->n0.x);
+    __m128  n0y = _mm_set1_ps(rt->n0.y);
+    __m128  n0z = _mm_set1_ps(rt->n0.z);
+    __m128  n1x = _mm_set1_ps(rt->n1.x);
+    __m128  n1y = _mm_set1_ps(rt->n1.y);
+    __m128  n1z = _mm_set1_ps(rt->n1.z);
+    __m128  n2x = _mm_set1_ps(rt->n2.x);
+    __m128  n2y = _mm_set1_ps(rt->n2.y);
+    __m128  n2z = _mm_set1_ps(rt->n2.z);
+    __m128  c255  = _mm_set1_ps(255);
+    __m128  clear = _mm_set1_ps(e->depth_far);
+
+    int     deferred = e->deferred;
+    __m128i id       = _mm_set1_epi32(rt - e->raster_tris);
+
+    int64_t row_w0 = ed.e0;
+    int64_t row_w1 = ed.e1;
+    int64_t row_w2 = ed.e2;
+
+    for (int y = min_y; y <= max_y; ++y) {
+        int64_t e0 = row_w0;
+        int64_t e1 = row_w1;
+        int64_t e2 = row_w2;
+
+        for (int bx = bx0; bx <= max_x; bx += 4) {
+            if (!use_simd || bx + 4 > t->x1 || !_fits_int32(e0, ed.step_x0, 4) || !_fits_int32(e1, ed.step_x1, 4) || !_fits_int32(e2, ed.step_x2, 4)) {
+                // Skip the lanes left of min_x before handing the block to the scalar path.
+                int x0 = MAX(bx, min_x);
+                _block_scalar(
+                    e, t, rt, &ed, x0, MIN(bx + 3, max_x), y,
+                    e0 + (x0 - bx) * ed.step_x0, e1 + (x0 - bx) * ed.step_x1, e2 + (x0 - bx) * ed.step_x2, full
+                );
+            } else {
+                __m128i v0 = _mm_add_epi32(_mm_set1_epi32((int32_t)e0), off0);
+                __m128i v1 = _mm_add_epi32(_mm_set1_epi32((int32_t)e1), off1);
+                __m128i v2 = _mm_add_epi32(_mm_set1_epi32((int32_t)e2), off2);
+
+                // Covered lanes: no edge function negative, and inside [min_x, max_x].
+                __m128i xs      = _mm_add_epi32(_mm_set1_epi32(bx), lane);
+                __m128i inside  = _mm_and_si128(_mm_cmpgt_epi32(xs, lo), _mm_cmpgt_epi32(hi, xs));
+                __m128i covered = full ? inside : _mm_andnot_si128(_mm_srai_epi32(_mm_or_si128(_mm_or_si128(v0, v1), v2), 31), inside);
+
+                if (_mm_movemask_ps(_mm_castsi128_ps(covered))) {
+                    // Barycentric coordinates.
+                    __m128 w0 = _mm_mul_ps(_mm_cvtepi32_ps(v0), area_inv);
+                    __m128 w1 = _mm_mul_ps(_mm_cvtepi32_ps(v1), area_inv);
+                    __m128 w2 = _mm_mul_ps(_mm_cvtepi32_ps(v2), area_inv);
+
+                    // Interpolate depth.
+                    __m128 z = _depth_round_sse2(e, _mm_add_ps(_mm_add_ps(_mm_mul_ps(z1, w0), _mm_mul_ps(z2, w1)), _mm_mul_ps(z3, w2)));
+
+                    // Depth test.
+                    int      depth = (e->window_width * y) + bx;
+                    __m128   buffer_depth = _depth_load_sse2(e, depth);
+                    __m128   first = _mm_cmpeq_ps(buffer_depth, clear);
+                    __m128i  pass  = _mm_and_si128(covered, _mm_castps_si128(_mm_cmplt_ps(z, buffer_depth)));
+
+                    t->pixels_tested  += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(covered)));
+                    t->pixels_written += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(pass)));
+                    t->pixels_covered += __builtin_popcount(_mm_movemask_ps(_mm_and_ps(_mm_castsi128_ps(pass), first)));
+
+                    if (_mm_movemask_ps(_mm_castsi128_ps(pass)) && deferred) {
+                        __m128i *vis = (__m128i *)&e->vis_buffer[(e->window_width * y) + bx];
+                        __m128i  old = _mm_loadu_si128(vis);
+                        _mm_storeu_si128(vis, _mm_or_si128(_mm_and_si128(pass, id), _mm_andnot_si128(pass, old)));
+
+                        _depth_store_sse2(e, depth, pass, z, buffer_depth);
+                    } else if (_mm_movemask_ps(_mm_castsi128_ps(pass))) {
+                        // Interpolate normal.
+                        __m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n0x, w0), _mm_mul_ps(n1x, w1)), _mm_mul_ps(n2x, w2));
+                        __m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n0y, w0), _mm_mul_ps(n1y, w1)), _mm_mul_ps(n2y, w2));
+                        __m128 nz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n0z, w0), _mm_mul_ps(n1z, w1)), _mm_mul_ps(n2z, w2));
+
+                        // Pack RGBA (truncating, and keeping the low byte, like Engine_set_pixel).
+                        __m128i r = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(nx, c255)), byte);
+                        __m128i g = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(ny, c255)), byte);
+                        __m128i b = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(nz, c255)), byte);
+                        __m128i rgba = _mm_or_si128(
+                            _mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                            _mm_or_si128(_mm_slli_epi32(b, 16), alpha)
+                        );
+
+                        // Masked stores. The colour buffer can be write-only texture memory (see
+                        // _begin_frame), so it's never read back: whole blocks are stored at once,
+                        // and otherwise only the lanes that passed, one by one.
+                        unsigned char *color = &e->color_buffer[(e->color_pitch * y) + bx * 4];
+                        int            mask  = _mm_movemask_ps(_mm_castsi128_ps(pass));
+                        if (mask == 0xF) {
+                            _mm_storeu_si128((__m128i *)color, rgba);
+                        } else {
+                            uint32_t lanes[4];
+                            _mm_storeu_si128((__m128i *)lanes, rgba);
+                            for (int k = 0; k < 4; ++k) {
+                                if (mask & (1 << k)) memcpy(&color[4 * k], &lanes[k], 4);
+                            }
+                        }
+
+                        _depth_store_sse2(e, depth, pass, z, buffer_depth);
+                    }
+                }
+            }
+
+            e0 += 4 * ed.step_x0;
+            e1 += 4 * ed.step_x1;
+            e2 += 4 * ed.step_x2;
+        }
+
+        row_w0 += ed.step_y0;
+        row_w1 += ed.step_y1;
+        row_w2 += ed.step_y2;
+    }
+}
+
+// Shades the pixels [x0, x1) of row y, all of which show the triangle, 4 at a time (see _resolve).
+// Advances ed past the pixels it shaded and returns the first pixel it left to the caller.
+static int _resolve_sse2(struct Engine *e, const struct RasterTri *rt, struct _Edges *ed, int x0, int x1, int y) {
+    if (!_fits_int32(0, ed->step_x0, 4) || !_fits_int32(0, ed->step_x1, 4) || !_fits_int32(0, ed->step_x2, 4)) {
+        return x0;
+    }
+
+    __m128i off0  = _mm_setr_epi32(0, ed->step_x0, 2 * ed->step_x0, 3 * ed->step_x0);
+    __m128i off1  = _mm_setr_epi32(0, ed->step_x1, 2 * ed->step_x1, 3 * ed->step_x1);
+    __m128i off2  = _mm_setr_epi32(0, ed->step_x2, 2 * ed->step_x2, 3 * ed->step_x2);
+    __m128i alpha = _mm_set1_epi32(0xFF000000);
+    __m128i byte  = _mm_set1_epi32(0xFF);
+
+    __m128  area_inv = _mm_set1_ps(rt->area_inv);
+    __m128  c255 = _mm_set1_ps(255);
+
+    int x = x0;
+    for (; x + 4 <= x1; x += 4) {
+        if (!_fits_int32(ed->e0, ed->step_x0, 4) || !_fits_int32(ed->e1, ed->step_x1, 4) || !_fits_int32(ed->e2, ed->step_x2, 4)) {
+            break;
+        }
+
+        __m128 w0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32((int32_t)ed->e0), off0)), area_inv);
+        __m128 w1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32((int32_t)ed->e1), off1)), area_inv);
+        __m128 w2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32((int32_t)ed->e2), off2)), area_inv);
+
+        __m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(rt->n0.x), w0), _mm_mul_ps(_mm_set1_ps(rt->n1.x), w1)), _mm_mul_ps(_mm_set1_ps(rt->n2.x), w2));
+        __m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(rt->n0.y), w0), _mm_mul_ps(_mm_set1_ps(rt->n1.y), w1)), _mm_mul_ps(_mm_set1_ps(rt->n2.y), w2));
+        __m128 nz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(rt->n0.z), w0), _mm_mul_ps(_mm_set1_ps(rt->n1.z), w1)), _mm_mul_ps(_mm_set1_ps(rt->n2.z), w2));
+
+        __m128i r = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(nx, c255)), byte);
+        __m128i g = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(ny, c255)), byte);
+        __m128i b = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(nz, c255)), byte);
+        __m128i rgba = _mm_or_si128(
+            _mm_or_si128(r, _mm_slli_epi32(g, 8)),
+            _mm_or_si128(_mm_slli_epi32(b, 16), alpha)
+        );
+        _mm_storeu_si128((__m128i *)&e->color_buffer[(e->color_pitch * y) + x * 4], rgba);
+
+        ed->e0 += 4 * ed->step_x0;
+        ed->e1 += 4 * ed->step_x1;
+        ed->e2 += 4 * ed->step_x2;
+    }
+
+    return x;
+}
+
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+// Depth buffer access for the 8 pixels from i (see _depth_load_sse2).
+
+__attribute__((target("avx2")))
+static inline __m256 _depth_round_avx2(const struct Engine *e, __m256 z) {
+    if (!_depth_integer(e)) {
+        return z;
+    }
+    z = _mm256_min_ps(_mm256_max_ps(z, _mm256_setzero_ps()), _mm256_set1_ps(e->depth_far));
+    return _mm256_cvtepi32_ps(_mm256_cvtps_epi32(z));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 _depth_load_avx2(const struct Engine *e, int i) {
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&((const uint16_t *)e->depth_buffer)[i])));
+        case RASTER_DEPTH_UNORM24: return _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)&((const uint32_t *)e->depth_buffer)[i]));
+        default:                   return _mm256_loadu_ps(&((const float *)e->depth_buffer)[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void _depth_store_avx2(struct Engine *e, int i, __m256i pass, __m256 z, __m256 old) {
+    switch (e->depth_format) {
+        case RASTER_DEPTH_UNORM16: {
+            // There's no masked 16 bit store, so blend with the old depths.
+            __m256i d = _mm256_cvtps_epi32(_mm256_blendv_ps(old, z, _mm256_castsi256_ps(pass)));
+            _mm_storeu_si128((__m128i *)&((uint16_t *)e->depth_buffer)[i], _mm_packus_epi32(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1)));
+            break;
+        }
+        case RASTER_DEPTH_UNORM24: _mm256_maskstore_epi32((int *)&((uint32_t *)e->depth_buffer)[i], pass, _mm256_cvtps_epi32(z)); break;
+        default:                   _mm256_maskstore_ps(&((float *)e->depth_buffer)[i], pass, z); break;
+    }
+}
+
+// Compiled for AVX2 regardless of the build flags; only called if the CPU supports it.
+__attribute__((target("avx2")))
+static void _fill_avx2(struct Engine *e, struct Tile *t, const struct RasterTri *rt, int min_x, int min_y, int max_x, int max_y, int full) {
+    int bx0 = min_x & ~7;
+
+    struct _Edges ed;
+    _edges_at(rt, bx0, min_y, &ed);
+
+    int use_simd = _fits_int32(0, ed.step_x0, 8) && _fits_int32(0, ed.step_x1, 8) && _fits_int32(0, ed.step_x2, 8);
+
+    __m256i lane  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i off0  = _mm256_mullo_epi32(lane, _mm256_set1_epi32(ed.step_x0));
+    __m256i off1  = _mm256_mullo_epi32(lane, _mm256_set1_epi32(ed.step_x1));
+    __m256i off2  = _mm256_mullo_epi32(lane, _mm256_set1_epi32(ed.step_x2));
+    __m256i lo    = _mm256_set1_epi32(min_x - 1);
+    __m256i hi    = _mm256_set1_epi32(max_x + 1);
+    __m256i alpha = _mm256_set1_epi32(0xFF000000);
+    __m256i byte  = _mm256_set1_epi32(0xFF);
+
+    __m256  area_inv = _mm256_set1_ps(rt->area_inv);
+    __m256  z1  = _mm256_set1_ps(rt->v0.z);
+    __m256  z2  = _mm256_set1_ps(rt->v1.z);
+    __m256  z3  = _mm256_set1_ps(rt->v2.z);
+    __m256  n0x = _mm256_set1_ps(rt->n0.x);
+    __m256  n0y = _mm256_set1_ps(rt->n0.y);
+    __m256  n0z = _mm256_set1_ps(rt->n0.z);
+    __m256  n1x = _mm256_set1_ps(rt->n1.x);
+    __m256  n1y = _mm256_set1_ps(rt->n1.y);
+    __m256  n1z = _mm256_set1_ps(rt->n1.z);
+    __m256  n2x = _mm256_set1_ps(rt->n2.x);
+    __m256  n2y = _mm256_set1_ps(rt->n2.y);
+    __m256  n2z = _mm256_set1_ps(rt->n2.z);
+    __m256  c255  = _mm256_set1_ps(255);
+    __m256  clear = _mm256_set1_ps(e->depth_far);
+
+    int     deferred = e->deferred;
+    __m256i id       = _mm256_set1_epi32(rt - e->raster_tris);
+
+    int64_t row_w0 = ed.e0;
+    int64_t row_w1 = ed.e1;
+    int64_t row_w2 = ed.e2;
+
+    for (int y = min_y; y <= max_y; ++y) {
+        int64_t e0 = row_w0;
+        int64_t e1 = row_w1;
+        int64_t e2 = row_w2;
+
+        for (int bx = bx0; bx <= max_x; bx += 8) {
+            if (!use_simd || bx + 8 > t->x1 || !_fits_int32(e0, ed.step_x0, 8) || !_fits_int32(e1, ed.step_x1, 8) || !_fits_int32(e2, ed.step_x2, 8)) {
+                int x0 = MAX(bx, min_x);
+                _block_scalar(
+                    e, t, rt, &ed, x0, MIN(bx + 7, max_x), y,
+                    e0 + (x0 - bx) * ed.step_x0, e1 + (x0 - bx) * ed.step_x1, e2 + (x0 - bx) * ed.step_x2, full
+                );
+            } else {
+                __m256i v0 = _mm256_add_epi32(_mm256_set1_epi32((int32_t)e0), off0);
+                __m256i v1 = _mm256_add_epi32(_mm256_set1_epi32((int32_t)e1), off1);
+                __m256i v2 = _mm256_add_epi32(_mm256_set1_epi32((int32_t)e2), off2);
+
+                __m256i xs      = _mm256_add_epi32(_mm256_set1_epi32(bx), lane);
+                __m256i inside  = _mm256_and_si256(_mm256_cmpgt_epi32(xs, lo), _mm256_cmpgt_epi32(hi, xs));
+                __m256i covered = full ? inside : _mm256_andnot_si256(_mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(v0, v1), v2), 31), inside);
+
+                if (_mm256_movemask_ps(_mm256_castsi256_ps(covered))) {
+                    __m256 w0 = _mm256_mul_ps(_mm256_cvtepi32_ps(v0), area_inv);
+                    __m256 w1 = _mm256_mul_ps(_mm256_cvtepi32_ps(v1), area_inv);
+                    __m256 w2 = _mm256_mul_ps(_mm256_cvtepi32_ps(v2), area_inv);
+
+                    __m256 z = _depth_round_avx2(e, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(z1, w0), _mm256_mul_ps(z2, w1)), _mm256_mul_ps(z3, w2)));
+
+                    int     depth = (e->window_width * y) + bx;
+                    __m256  buffer_depth = _depth_load_avx2(e, depth);
+                    __m256  first = _mm256_cmp_ps(buffer_depth, clear, _CMP_EQ_OQ);
+                    __m256i pass  = _mm256_and_si256(covered, _mm256_castps_si256(_mm256_cmp_ps(z, buffer_depth, _CMP_LT_OQ)));
+
+                    t->pixels_tested  += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(covered)));
+                    t->pixels_written += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(pass)));
+                    t->pixels_covered += __builtin_popcount(_mm256_movemask_ps(_mm256_and_ps(_mm256_castsi256_ps(pass), first)));
+
+                    if (_mm256_movemask_ps(_mm256_castsi256_ps(pass)) && deferred) {
+                        _mm256_maskstore_epi32((int *)&e->vis_buffer[(e->window_width * y) + bx], pass, id);
+                        _depth_store_avx2(e, depth, pass, z, buffer_depth);
+                    } else if (_mm256_movemask_ps(_mm256_castsi256_ps(pass))) {
+                        __m256 nx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n0x, w0), _mm256_mul_ps(n1x, w1)), _mm256_mul_ps(n2x, w2));
+                        __m256 ny = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n0y, w0), _mm256_mul_ps(n1y, w1)), _mm256_mul_ps(n2y, w2));
+                        __m256 nz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n0z, w0), _mm256_mul_ps(n1z, w1)), _mm256_mul_ps(n2z, w2));
+
+                        __m256i r = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(nx, c255)), byte);
+                        __m256i g = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(ny, c255)), byte);
+                        __m256i b = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(nz, c255)), byte);
+                        __m256i rgba = _mm256_or_si256(
+                            _mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+                            _mm256_or_si256(_mm256_slli_epi32(b, 16), alpha)
+                        );
+
+                        _mm256_maskstore_epi32((int *)&e->color_buffer[(e->color_pitch * y) + bx * 4], pass, rgba);
+                        _depth_store_avx2(e, depth, pass, z, buffer_depth);
+                    }
+                }
+            }
+
+            e0 += 8 * ed.step_x0;
+            e1 += 8 * ed.step_x1;
+            e2 += 8 * ed.step_x2;
+        }
+
+        row_w0 += ed.step_y0;
+        row_w1 += ed.step_y1;
+        row_w2 += ed.step_y2;
+    }
+}
+
+#endif
+
+int Raster_best_kernel(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (SDL_HasAVX2()) return RASTER_KERNEL_AVX2;
+#endif
+#if defined(__SSE2__)
+    if (SDL_HasSSE2()) return RASTER_KERNEL_SSE2;
+#endif
+    return RASTER_KERNEL_SCALAR;
+}
+
+const char *Raster_kernel_name(int kernel) {
+    switch (kernel) {
+        case RASTER_KERNEL_SSE2: return "SSE2";
+        case RASTER_KERNEL_AVX2: return "AVX2";
+        default:                 return "scalar";
+    }
+}
+
+// Depth formats. Integer formats store z / w scaled to their range and rounded, and every format
+// is cleared to the farthest value it stores. Reversed Z is stored as -near / w, in [-1, 0): the
+// negation keeps nearer depths smaller like in the other formats, and costs no precision.
+
+void Raster_set_depth_format(struct Engine *e, int format) {
+    size_t depth_size;
+    switch (format) {
+        case RASTER_DEPTH_UNORM16:  depth_size = sizeof(uint16_t); e->depth_scale = 0xFFFF;   e->depth_far = 0xFFFF;   break;
+        case RASTER_DEPTH_UNORM24:  depth_size = sizeof(uint32_t); e->depth_scale = 0xFFFFFF; e->depth_far = 0xFFFFFF; break;
+        case RASTER_DEPTH_REVERSED: depth_size = sizeof(float);    e->depth_scale = 1;        e->depth_far = 0;        break;
+        default:                    depth_size = sizeof(float);    e->depth_scale = 1;        e->depth_far = 1;        break;
+    }
+
+    // Tiles clear their depth before drawing, so the contents don't matter.
+    e->depth_format      = format;
+    e->depth_buffer_size = depth_size * e->num_window_pixels;
+    free(e->depth_buffer);
+    e->depth_buffer = malloc(e->depth_buffer_size);
+}
+
+const char *Raster_depth_format_name(int format) {
+    switch (format) {
+        case RASTER_DEPTH_UNORM16:  return "unorm16";
+        case RASTER_DEPTH_UNORM24:  return "unorm24";
+        case RASTER_DEPTH_REVERSED: return "reversed";
+        default:                    return "float";
+    }
+}
+
+// Hierarchical Z. Every BLOCK_SIZE x BLOCK_SIZE block of the depth buffer has an upper bound on its
+// depth in hiz_buffer (the farthest depth while any pixel is still clear). Depth writes only ever lower the
+// depth of a pixel, so a bound stays valid after writes. Fully covered blocks tighten it directly;
+// partially covered ones mark it dirty so it's recomputed the next time it fails to reject.
+
+static void _hiz_update(struct Engine *e, int block) {
+    int x0 = (block % e->hiz_width) * BLOCK_SIZE;
+    int y0 = (block / e->hiz_width) * BLOCK_SIZE;
+    int x1 = MIN(x0 + BLOCK_SIZE, e->window_width);
+    int y1 = MIN(y0 + BLOCK_SIZE, e->window_height);
+
+    float max_depth = -INFINITY;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            float depth = _depth_load(e, e->window_width * y + x);
+            max_depth = MAX(max_depth, depth);
+        }
+    }
+
+    e->hiz_buffer[block] = max_depth;
+    e->hiz_dirty[block]  = 0;
+}
+
+// Nonzero if nothing at depth z_min or farther can pass the depth test anywhere in the block.
+static inline int _hiz_occluded(struct Engine *e, int block, float z_min) {
+    if (z_min >= e->hiz_buffer[block]) {
+        return 1;
+    }
+    if (!e->hiz_dirty[block]) {
+        return 0;
+    }
+    _hiz_update(e, block);
+    return z_min >= e->hiz_buffer[block];
+}
+
+// Depth range of the triangle at the pixel centers of a fully covered w x h block, from its corners
+// (depth is affine in the block, and the corner barycentrics are as accurate as the pixels').
+static inline void _block_z_range(const struct Engine *e, const struct RasterTri *rt, const struct _Edges *ed, int w, int h, float *z_min, float *z_max) {
+    *z_min = INFINITY;
+    *z_max = -INFINITY;
+
+    for (int corner = 0; corner < 4; ++corner) {
+        int64_t dx = (corner & 1) ? w - 1 : 0;
+        int64_t dy = (corner & 2) ? h - 1 : 0;
+
+        float w0 = (ed->e0 + dx * ed->step_x0 + dy * ed->step_y0) * rt->area_inv;
+        float w1 = (ed->e1 + dx * ed->step_x1 + dy * ed->step_y1) * rt->area_inv;
+        float w2 = (ed->e2 + dx * ed->step_x2 + dy * ed->step_y2) * rt->area_inv;
+        float z  = rt->v0.z * w0 + rt->v1.z * w1 + rt->v2.z * w2;
+
+        *z_min = MIN(*z_min, z);
+        *z_max = MAX(*z_max, z);
+    }
+
+    *z_min = MAX(*z_min - fabsf(*z_min) * HIZ_EPSILON - _depth_rounding(e), rt->z_min);
+    *z_max = *z_max + fabsf(*z_max) * HIZ_EPSILON + _depth_rounding(e);
+}
+
+static inline void _fill_block(struct Engine *e, struct Tile *t, const struct RasterTri *rt, int min_x, int min_y, int max_x, int max_y, int full) {
+    if (e->hiz && !full) {
+        for (int by = min_y / BLOCK_SIZE; by <= max_y / BLOCK_SIZE; ++by) {
+            for (int bx = min_x / BLOCK_SIZE; bx <= max_x / BLOCK_SIZE; ++bx) {
+                e->hiz_dirty[by * e->hiz_width + bx] = 1;
+            }
+        }
+    }
+
+    switch (e->raster_kernel) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        case RASTER_KERNEL_AVX2: _fill_avx2(e, t, rt, min_x, min_y, max_x, max_y, full); break;
+#endif
+#if defined(__SSE2__)
+        case RASTER_KERNEL_SSE2: _fill_sse2(e, t, rt, min_x, min_y, max_x, max_y, full); break;
+#endif
+        default:                 _fill_scalar(e, t, rt, min_x, min_y, max_x, max_y, full); break;
+    }
+}
+
+// Smallest and largest value of an edge function over the pixel centers of a block, given its
+// value at the block's top left pixel center. The function is linear, so both are at corners.
+static inline void _edge_range(int64_t e, int64_t step_x, int64_t step_y, int w, int h, int64_t *lo, int64_t *hi) {
+    int64_t dx = step_x * (w - 1);
+    int64_t dy = step_y * (h - 1);
+
+    *lo = e + MIN(dx, 0) + MIN(dy, 0);
+    *hi = e + MAX(dx, 0) + MAX(dy, 0);
+}
+
+#define BLOCK_REJECT  0
+#define BLOCK_PARTIAL 1
+#define BLOCK_FULL    2
+
+// Two level traversal: the triangle's bounds within the tile are split into BLOCK_SIZE x BLOCK_SIZE
+// blocks. Blocks entirely outside an edge are skipped, blocks entirely inside all edges are filled
+// without coverage tests, and only blocks straddling an edge are tested per pixel.
+static inline void _fill(struct Engine *e, struct Tile *t, const struct RasterTri *rt) {
+    // Bounding box of triangle (also considering the bounds of the tile).
+    int min_x = MAX(rt->min_x, t->x0);
+    int max_x = MIN(rt->max_x, t->x1 - 1);
+    int min_y = MAX(rt->min_y, t->y0);
+    int max_y = MIN(rt->max_y, t->y1 - 1);
+
+    if (min_x > max_x || min_y > max_y) {
+        return;
+    }
+
+    // Small triangles gain nothing from block classification, but can still be rejected as a
+    // whole if they're behind every block they overlap.
+    if (max_x - min_x < BLOCK_SIZE && max_y - min_y < BLOCK_SIZE) {
+        if (e->hiz) {
+            int occluded = 1;
+            for (int by = min_y / BLOCK_SIZE; by <= max_y / BLOCK_SIZE && occluded; ++by) {
+                for (int bx = min_x / BLOCK_SIZE; bx <= max_x / BLOCK_SIZE && occluded; ++bx) {
+                    occluded = _hiz_occluded(e, by * e->hiz_width + bx, rt->z_min);
+                }
+            }
+            if (occluded) {
+                ++t->hiz_rejected_tris;
+                return;
+            }
+        }
+
+        _fill_block(e, t, rt, min_x, min_y, max_x, max_y, 0);
+        return;
+    }
+
+    int num_visible_blocks  = 0;
+    int num_rejected_blocks = 0;
+
+    struct _Edges ed;
+    int64_t lo0, lo1, lo2;
+    int64_t hi0, hi1, hi2;
+
+    // Blocks are aligned to the tile (whose origin is a multiple of BLOCK_SIZE).
+    for (int by = min_y & ~(BLOCK_SIZE - 1); by <= max_y; by += BLOCK_SIZE) {
+        int y0 = MAX(by, min_y);
+        int y1 = MIN(by + BLOCK_SIZE - 1, max_y);
+
+        // Consecutive blocks of the same kind are handed to the kernel as one run, which
+        // amortizes the kernel's setup over the row.
+        int run_kind = BLOCK_REJECT;
+        int run_x0   = 0;
+        int run_x1   = 0;
+
+        for (int bx = min_x & ~(BLOCK_SIZE - 1); bx <= max_x; bx += BLOCK_SIZE) {
+            int x0 = MAX(bx, min_x);
+            int x1 = MIN(bx + BLOCK_SIZE - 1, max_x);
+
+            _edges_at(rt, x0, y0, &ed);
+            _edge_range(ed.e0, ed.step_x0, ed.step_y0, x1 - x0 + 1, y1 - y0 + 1, &lo0, &hi0);
+            _edge_range(ed.e1, ed.step_x1, ed.step_y1, x1 - x0 + 1, y1 - y0 + 1, &lo1, &hi1);
+            _edge_range(ed.e2, ed.step_x2, ed.step_y2, x1 - x0 + 1, y1 - y0 + 1, &lo2, &hi2);
+
+            int kind;
+            if ((hi0 | hi1 | hi2) < 0) {
+                // Trivial reject: some edge is negative at every pixel center of the block.
+                kind = BLOCK_REJECT;
+            } else if ((lo0 | lo1 | lo2) >= 0) {
+                // Trivial accept: no edge is negative anywhere in the block.
+                kind = BLOCK_FULL;
+            } else {
+                kind = BLOCK_PARTIAL;
+            }
+
+            // Hi-Z reject: the triangle is behind everything drawn in the block so far.
+            if (kind != BLOCK_REJECT && e->hiz) {
+                int block = (by / BLOCK_SIZE) * e->hiz_width + bx / BLOCK_SIZE;
+
+                float z_min = rt->z_min;
+                float z_max = INFINITY;
+                if (kind == BLOCK_FULL) {
+                    _block_z_range(e, rt, &ed, x1 - x0 + 1, y1 - y0 + 1, &z_min, &z_max);
+                }
+
+                if (_hiz_occluded(e, block, z_min)) {
+                    kind = BLOCK_REJECT;
+                    ++num_rejected_blocks;
+                } else if (x1 - x0 + 1 == BLOCK_SIZE && y1 - y0 + 1 == BLOCK_SIZE) {
+                    // Once filled, no pixel of a fully covered block is farther than z_max.
+                    e->hiz_buffer[block] = MIN(e->hiz_buffer[block], z_max);
+                }
+            }
+
+            num_visible_blocks += kind != BLOCK_REJECT;
+
+            if (kind != run_kind) {
+                if (run_kind != BLOCK_REJECT) {
+                    _fill_block(e, t, rt, run_x0, y0, run_x1, y1, run_kind == BLOCK_FULL);
+                }
+                run_kind = kind;
+                run_x0   = x0;
+            }
+            run_x1 = x1;
+        }
+
+        if (run_kind != BLOCK_REJECT) {
+            _fill_block(e, t, rt, run_x0, y0, run_x1, y1, run_kind == BLOCK_FULL);
+        }
+    }
+
+    t->hiz_rejected_blocks += num_rejected_blocks;
+    if (num_visible_blocks == 0 && num_rejected_blocks > 0) {
+        ++t->hiz_rejected_tris;
+    }
+}
+
+// Shading pass of deferred mode: shades every covered pixel of the tile from the triangle in the
+// visibility buffer, reconstructing the same barycentrics the raster pass had, and clears the rest.
+// Neighbouring pixels mostly share a triangle, so edge functions are stepped along runs of an ID.
+static void _resolve(struct Engine *e, struct Tile *t) {
+    for (int y = t->y0; y < t->y1; ++y) {
+        const uint32_t *vis = &e->vis_buffer[e->window_width * y];
+
+        int x = t->x0;
+        while (x < t->x1) {
+            uint32_t id = vis[x];
+            int run_x0 = x;
+            while (x < t->x1 && vis[x] == id) ++x;
+
+            if (id == RASTER_VIS_NONE) {
+                memset(&e->color_buffer[(e->color_pitch * y) + run_x0 * 4], 0, (x - run_x0) * 4);
+                continue;
+            }
+
+            const struct RasterTri *rt = &e->raster_tris[id];
+            t->pixels_shaded += x - run_x0;
+
+            struct _Edges ed;
+            _edges_at(rt, run_x0, y, &ed);
+
+            int px = run_x0;
+#if defined(__SSE2__)
+            if (e->raster_kernel != RASTER_KERNEL_SCALAR) {
+                px = _resolve_sse2(e, rt, &ed, px, x, y);
+            }
+#endif
+            for (; px < x; ++px) {
+                _shade(e, rt, px, y, ed.e0 * rt->area_inv, ed.e1 * rt->area_inv, ed.e2 * rt->area_inv);
+                ed.e0 += ed.step_x0;
+                ed.e1 += ed.step_x1;
+                ed.e2 += ed.step_x2;
+            }
+        }
+    }
+}
+
+void Raster_tile(struct Engine *e, struct Tile *t) {
+    // Wireframes aren't filled, so they have nothing to defer.
+    int deferred = e->deferred && !e->wireframe;
+
+    t->hiz_rejected_blocks = 0;
+    t->hiz_rejected_tris   = 0;
+    t->pixels_tested       = 0;
+    t->pixels_written      = 0;
+    t->pixels_shaded       = 0;
+    t->pixels_covered      = 0;
+
+    // Frame buffers are cleared lazily. A tile no triangle overlaps only needs its colour cleared,
+    // and only if something was drawn in it since it was last cleared. Its depth is never read.
+    if (t->num_tris == 0) {
+        if (!t->clear) {
+            for (int y = t->y0; y < t->y1; ++y) {
+                memset(&e->color_buffer[(e->color_pitch * y) + t->x0 * 4], 0, (t->x1 - t->x0) * 4);
+            }
+            t->clear = 1;
+        }
+        return;
+    }
+
+    // Otherwise clear the tile's part of the frame buffers. In deferred mode, _resolve writes every
+    // pixel, and colour that is still clear doesn't need it again.
+    for (int y = t->y0; y < t->y1; ++y) {
+        if (deferred) {
+            for (int x = t->x0; x < t->x1; ++x) {
+                e->vis_buffer[(e->window_width * y) + x] = RASTER_VIS_NONE;
+            }
+        } else if (!t->clear) {
+            memset(&e->color_buffer[(e->color_pitch * y) + t->x0 * 4], 0, (t->x1 - t->x0) * 4);
+        }
+        _depth_clear(e, (e->window_width * y) + t->x0, t->x1 - t->x0);
+    }
+    for (int by = t->y0 / BLOCK_SIZE; by * BLOCK_SIZE < t->y1; ++by) {
+        for (int bx = t->x0 / BLOCK_SIZE; bx * BLOCK_SIZE < t->x1; ++bx) {
+            e->hiz_buffer[by * e->hiz_width + bx] = e->depth_far;
+            e->hiz_dirty[by * e->hiz_width + bx]  = 0;
+        }
+    }
+
+    t->clear = 0;
+
+    for (int i = 0; i < t->num_tris; ++i) {
+        const struct RasterTri *rt = &e->raster_tris[t->tris[i]];
+
+        // Draw vertex normals (over the shaded tile, in deferred mode).
+        if (e->show_vertex_normals && !deferred) {
+            _line(e, t, rt->v0.x, rt->v0.y, rt->vn0.x, rt->vn0.y, 255, 255, 255);
+            _line(e, t, rt->v1.x, rt->v1.y, rt->vn1.x, rt->vn1.y, 255, 255, 255);
+            _line(e, t, rt->v2.x, rt->v2.y, rt->vn2.x, rt->vn2.y, 255, 255, 255);
+        }
+
+        if (e->wireframe) {
+            _line(e, t, rt->v0.x, rt->v0.y, rt->v1.x, rt->v1.y, 255, 255, 255);
+            _line(e, t, rt->v1.x, rt->v1.y, rt->v2.x, rt->v2.y, 255, 255, 255);
+            _line(e, t, rt->v2.x, rt->v2.y, rt->v0.x, rt->v0.y, 255, 255, 255);
+            continue;
+        }
+
+        if (rt->fill) {
+            _fill(e, t, rt);
+        }
+    }
+
+    // Without deferring, every pixel that passes the depth test is shaded.
+    if (!deferred) {
+        t->pixels_shaded = t->pixels_written;
+    }
+
+    if (deferred) {
+        _resolve(e, t);
+
+        if (e->show_vertex_normals) {
+            for (int i = 0; i < t->num_tris; ++i) {
+                const struct RasterTri *rt = &e->raster_tris[t->tris[i]];
+                _line(e, t, rt->v0.x, rt->v0.y, rt->vn0.x, rt->vn0.y, 255, 255, 255);
+                _line(e, t, rt->v1.x, rt->v1.y, rt->vn1.x, rt->vn1.y, 255, 255, 255);
+                _line(e, t, rt->v2.x, rt->v2.y, rt->vn2.x, rt->vn2.y, 255, 255, 255);
+            }
+        }
+    }
+}
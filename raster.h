@@ -0,0 +1,133 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "vector3.h"
+#include "util.h"
+
+// Side length (in pixels) of a screen tile. A 64 x 64 tile of colour and depth is 32 KB,
+// which keeps the tile resident in L1/L2 while its triangles are rasterized.
+#define TILE_SIZE 64
+
+// Side length (in pixels) of the blocks used for hierarchical traversal within a tile.
+// Must divide TILE_SIZE.
+#define BLOCK_SIZE 8
+
+// Relative margin applied to nearest depths before testing them against the Hi-Z buffer,
+// which keeps Hi-Z rejection conservative with respect to float rounding.
+#define HIZ_EPSILON 1e-6f
+
+// Screen vertices are snapped to a 28.4 fixed point grid before rasterization.
+#define SUBPIXEL_BITS  4
+#define SUBPIXEL_SCALE (1 << SUBPIXEL_BITS)
+
+// Largest screen coordinate (in pixels) the fixed point setup represents. Keeps every
+// edge function coefficient within 32 bits (and products within 64 bits).
+#define RASTER_MAX_COORD (1 << 25)
+
+// Pixel kernels used to fill triangles. The SIMD kernels process 4 x 1 (SSE2) or 8 x 1 (AVX2)
+// pixel blocks at a time and produce the same output as the scalar one, which is kept as a
+// reference.
+#define RASTER_KERNEL_SCALAR 0
+#define RASTER_KERNEL_SSE2   1
+#define RASTER_KERNEL_AVX2   2
+
+// Depth buffer formats. Every format stores smaller values for nearer surfaces and is cleared to
+// its farthest value, so the depth test is a single comparison. Integer formats trade precision
+// for bandwidth; reversed Z spends float precision evenly over distance and has no far plane.
+#define RASTER_DEPTH_FLOAT    0 // 32 bit float z / w, in [0, 1] between the near and far planes.
+#define RASTER_DEPTH_UNORM16  1 // z / w as 16 bit unsigned normalized integers.
+#define RASTER_DEPTH_UNORM24  2 // z / w as 24 bit unsigned normalized integers (in 32 bit words).
+#define RASTER_DEPTH_REVERSED 3 // 32 bit float near / (view depth), negated (see Raster_set_depth_format).
+#define RASTER_NUM_DEPTH_FORMATS 4
+
+// Visibility buffer value of pixels no triangle covers.
+#define RASTER_VIS_NONE UINT32_MAX
+
+// A triangle after the viewport transform, ready to be rasterized.
+struct RasterTri {
+    // Screen space vertices.
+    struct Vector3 v0, v1, v2;
+
+    // Screen space tips of the vertex normals (only drawn if show_vertex_normals).
+    struct Vector3 vn0, vn1, vn2;
+
+    // Vertex normals remapped to [0, 1] for colouring.
+    struct Vector3 n0, n1, n2;
+
+    // Fixed point setup (see Raster_setup_tri).
+
+    // Nonzero if the triangle covers any pixel centers.
+    int fill;
+
+    // Inclusive pixel bounds of the fill, clamped to the screen.
+    int min_x, min_y, max_x, max_y;
+
+    // Edge function i is a_i * x + b_i * y + c_i (in 24.8 fixed point) for the edge opposite
+    // vertex i, with the fill rule bias folded into c_i. A pixel center is covered iff all
+    // three are non-negative.
+    int32_t a0, a1, a2;
+    int32_t b0, b1, b2;
+    int64_t c0, c1, c2;
+
+    // Reciprocal of twice the (fixed point) area, for barycentric coordinates.
+    float area_inv;
+
+    // Lower bound on the depth of any pixel of the triangle.
+    float z_min;
+};
+
+// A tile of the frame buffer and the triangles that overlap it, in submission order.
+struct Tile {
+    // Pixel bounds [x0, x1) x [y0, y1).
+    int x0, y0, x1, y1;
+
+    int *tris;
+    int  num_tris;
+    int  capacity;
+
+    // Work skipped thanks to the Hi-Z buffer in the last frame.
+    int hiz_rejected_blocks;
+    int hiz_rejected_tris;
+
+    // Pixels depth tested, pixels that passed the depth test, pixels shaded and pixels written at
+    // least once, in the last frame. Passed over written is the overdraw.
+    int pixels_tested;
+    int pixels_written;
+    int pixels_shaded;
+    int pixels_covered;
+
+    // Nonzero while the tile's colour is all clear colour, which spares clearing it again until
+    // something is drawn in it (see Raster_tile).
+    int clear;
+};
+
+struct Engine; // Forward declaration.
+
+// Sort-middle rasterization: triangles are binned into every tile their screen bounds
+// overlap, then each tile is cleared and rasterized independently (and in parallel).
+// Within a tile, triangles are processed in submission order, so the output does not
+// depend on how tiles are distributed among threads.
+//
+// In deferred mode, filling a triangle only writes depth and the triangle's index (its ID) to the
+// visibility buffer. Once all triangles of a tile are in, every covered pixel is shaded exactly
+// once from the triangle it ended up with, so shading cost doesn't grow with overdraw.
+
+void        Raster_create_tiles(struct Engine *e);
+void        Raster_destroy_tiles(struct Engine *e);
+inline void Raster_setup_tri(struct Engine *e, struct RasterTri *rt);
+void        Raster_sort_tris(struct Engine *e); // Fills raster_order front to back (see raster.c).
+inline void Raster_bin_tri(struct Engine *e, int tri_index);
+void        Raster_tile(struct Engine *e, struct Tile *t);
+
+int         Raster_best_kernel(void); // Best kernel supported by the build and the CPU.
+const char *Raster_kernel_name(int kernel);
+
+// (Re)allocates the depth buffer in one of the RASTER_DEPTH_* formats. Call between frames.
+void        Raster_set_depth_format(struct Engine *e, int format);
+const char *Raster_depth_format_name(int format);
+
+#endif
@@ -0,0 +1,389 @@
+#include "scene.h"
+
+struct Scene *Scene_create() {
+    struct Scene *s = malloc(sizeof(struct Scene));
+
+    s->models_capacity = 16;
+    s->num_models      = 0;
+    s->models          = malloc(sizeof(struct Model *) * s->models_capacity);
+    s->leaves          = malloc(sizeof(int) * s->models_capacity);
+
+    // A binary tree with one model per leaf has 2n - 1 nodes.
+    s->nodes     = malloc(sizeof(struct SceneNode) * (2 * s->models_capacity - 1));
+    s->num_nodes = 0;
+    s->built     = 0;
+
+    s->instances_capacity = 4;
+    s->num_instances      = 0;
+    s->instances          = malloc(sizeof(struct Instances *) * s->instances_capacity);
+
+    return s;
+}
+
+void Scene_destroy(struct Scene *s) {
+    for (int i = 0; i < s->num_models; ++i) {
+        Model_destroy(s->models[i]);
+    }
+    for (int i = 0; i < s->num_instances; ++i) {
+        Instances_destroy(s->instances[i]);
+    }
+    free(s->models);
+    free(s->instances);
+    free(s->leaves);
+    free(s->nodes);
+    free(s);
+}
+
+int Scene_add(struct Scene *s, struct Model *m) {
+    if (s->num_models == s->models_capacity) {
+        s->models_capacity *= 2;
+        s->models = realloc(s->models, sizeof(struct Model *) * s->models_capacity);
+        s->leaves = realloc(s->leaves, sizeof(int) * s->models_capacity);
+        s->nodes  = realloc(s->nodes,  sizeof(struct SceneNode) * (2 * s->models_capacity - 1));
+    }
+
+    s->models[s->num_models] = m;
+    s->built = 0;
+
+    return s->num_models++;
+}
+
+int Scene_add_instances(struct Scene *s, struct Instances *inst) {
+    if (s->num_instances == s->instances_capacity) {
+        s->instances_capacity *= 2;
+        s->instances = realloc(s->instances, sizeof(struct Instances *) * s->instances_capacity);
+    }
+
+    s->instances[s->num_instances] = inst;
+
+    return s->num_instances++;
+}
+
+// World space bounds of a model: its box in model space, transformed (Arvo's method).
+static void _model_bounds(const struct Model *m, struct Vector3 *min, struct Vector3 *max) {
+    const struct Matrix4 *a = &m->model_to_world;
+    struct Vector3 center = Matrix4_vmul(a, Vector3_smul(Vector3_add(m->aabb_min, m->aabb_max), 0.5));
+    struct Vector3 extent = Vector3_smul(Vector3_sub(m->aabb_max, m->aabb_min), 0.5);
+
+    struct Vector3 world_extent = {
+        fabsf(a->x00) * extent.x + fabsf(a->x01) * extent.y + fabsf(a->x02) * extent.z,
+        fabsf(a->x10) * extent.x + fabsf(a->x11) * extent.y + fabsf(a->x12) * extent.z,
+        fabsf(a->x20) * extent.x + fabsf(a->x21) * extent.y + fabsf(a->x22) * extent.z,
+        0
+    };
+
+    *min = Vector3_sub(center, world_extent);
+    *max = Vector3_add(center, world_extent);
+}
+
+static void _union(struct SceneNode *n, const struct SceneNode *a, const struct SceneNode *b) {
+    n->min = (struct Vector3){MIN(a->min.x, b->min.x), MIN(a->min.y, b->min.y), MIN(a->min.z, b->min.z), 1};
+    n->max = (struct Vector3){MAX(a->max.x, b->max.x), MAX(a->max.y, b->max.y), MAX(a->max.z, b->max.z), 1};
+}
+
+// Axis along which _build sorts leaves (qsort has no context argument).
+static int _build_axis;
+
+static int _compare_leaves(const void *a, const void *b) {
+    const struct SceneNode *na = a;
+    const struct SceneNode *nb = b;
+    float ca = _build_axis == 0 ? na->min.x + na->max.x : _build_axis == 1 ? na->min.y + na->max.y : na->min.z + na->max.z;
+    float cb = _build_axis == 0 ? nb->min.x + nb->max.x : _build_axis == 1 ? nb->min.y + nb->max.y : nb->min.z + nb->max.z;
+    return (ca > cb) - (ca < cb);
+}
+
+// Builds the subtree over n leaves and returns its root. Nodes are split at the
+// median along the longest axis of their leaves' centers.
+static int _build(struct Scene *s, struct SceneNode *leaves, int n, int parent) {
+    int id = s->num_nodes++;
+    struct SceneNode *node = &s->nodes[id];
+
+    if (n == 1) {
+        *node = leaves[0];
+        node->parent = parent;
+        s->leaves[node->model] = id;
+        return id;
+    }
+
+    struct Vector3 cmin = Vector3_add(leaves[0].min, leaves[0].max);
+    struct Vector3 cmax = cmin;
+    for (int i = 1; i < n; ++i) {
+        struct Vector3 c = Vector3_add(leaves[i].min, leaves[i].max);
+        cmin = (struct Vector3){MIN(cmin.x, c.x), MIN(cmin.y, c.y), MIN(cmin.z, c.z), 0};
+        cmax = (struct Vector3){MAX(cmax.x, c.x), MAX(cmax.y, c.y), MAX(cmax.z, c.z), 0};
+    }
+
+    struct Vector3 size = Vector3_sub(cmax, cmin);
+    _build_axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+    qsort(leaves, n, sizeof(struct SceneNode), _compare_leaves);
+
+    int left  = _build(s, leaves, n / 2, id);
+    int right = _build(s, &leaves[n / 2], n - n / 2, id);
+
+    node->parent = parent;
+    node->left   = left;
+    node->right  = right;
+    node->model  = -1;
+    _union(node, &s->nodes[left], &s->nodes[right]);
+
+    return id;
+}
+
+void Scene_update(struct Scene *s) {
+    if (!s->built) {
+        s->num_nodes = 0;
+        if (s->num_models > 0) {
+            struct SceneNode *leaves = malloc(sizeof(struct SceneNode) * s->num_models);
+            for (int i = 0; i < s->num_models; ++i) {
+                _model_bounds(s->models[i], &leaves[i].min, &leaves[i].max);
+                leaves[i].left  = -1;
+                leaves[i].right = -1;
+                leaves[i].model = i;
+                s->models[i]->transform_changed = 0;
+            }
+            _build(s, leaves, s->num_models, -1);
+            free(leaves);
+        }
+        s->built = 1;
+        return;
+    }
+
+    // Refit: recompute the leaves of moved models, then their ancestors.
+    for (int i = 0; i < s->num_models; ++i) {
+        struct Model *m = s->models[i];
+        if (!m->transform_changed) {
+            continue;
+        }
+        m->transform_changed = 0;
+
+        struct SceneNode *node = &s->nodes[s->leaves[i]];
+        _model_bounds(m, &node->min, &node->max);
+
+        for (int p = node->parent; p >= 0; p = s->nodes[p].parent) {
+            _union(&s->nodes[p], &s->nodes[s->nodes[p].left], &s->nodes[s->nodes[p].right]);
+        }
+    }
+}
+
+int Scene_bounds(const struct Scene *s, struct Vector3 *min, struct Vector3 *max) {
+    int found = s->num_nodes > 0;
+    if (found) {
+        *min = s->nodes[0].min;
+        *max = s->nodes[0].max;
+    }
+
+    for (int i = 0; i < s->num_instances; ++i) {
+        const struct Instances *inst = s->instances[i];
+        for (int j = 0; j < inst->count; ++j) {
+            struct Vector3 c = inst->sphere_centers[j];
+            float          r = inst->sphere_radii[j];
+            if (!found) {
+                *min = c;
+                *max = c;
+                found = 1;
+            }
+            *min = Vector3_create_point(MIN(min->x, c.x - r), MIN(min->y, c.y - r), MIN(min->z, c.z - r));
+            *max = Vector3_create_point(MAX(max->x, c.x + r), MAX(max->y, c.y + r), MAX(max->z, c.z + r));
+        }
+    }
+
+    return found;
+}
+
+// Appends every model below a node.
+static int _collect(const struct Scene *s, int node, int *out) {
+    int stack[SCENE_MAX_DEPTH];
+    int top = 0;
+    int n   = 0;
+
+    stack[top++] = node;
+    while (top > 0) {
+        const struct SceneNode *sn = &s->nodes[stack[--top]];
+        if (sn->model >= 0) {
+            out[n++] = sn->model;
+        } else {
+            stack[top++] = sn->right;
+            stack[top++] = sn->left;
+        }
+    }
+
+    return n;
+}
+
+int Scene_frustum_query(const struct Scene *s, const struct Vector3 planes[6], int *out) {
+    if (s->num_nodes == 0) {
+        return 0;
+    }
+
+    int stack[SCENE_MAX_DEPTH];
+    int top = 0;
+    int n   = 0;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        int node = stack[--top];
+        const struct SceneNode *sn = &s->nodes[node];
+
+        int visibility = Clip_test_aabb(planes, sn->min, sn->max);
+        if (visibility == CLIP_OUTSIDE) {
+            continue;
+        }
+
+        // Everything below a node inside the frustum is visible without further tests.
+        if (visibility == CLIP_INSIDE || sn->model >= 0) {
+            n += _collect(s, node, &out[n]);
+        } else {
+            stack[top++] = sn->right;
+            stack[top++] = sn->left;
+        }
+    }
+
+    return n;
+}
+
+int Scene_point_query(const struct Scene *s, struct Vector3 point, int *out) {
+    if (s->num_nodes == 0) {
+        return 0;
+    }
+
+    int stack[SCENE_MAX_DEPTH];
+    int top = 0;
+    int n   = 0;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        const struct SceneNode *sn = &s->nodes[stack[--top]];
+
+        if (point.x < sn->min.x || point.x > sn->max.x ||
+            point.y < sn->min.y || point.y > sn->max.y ||
+            point.z < sn->min.z || point.z > sn->max.z) {
+            continue;
+        }
+
+        if (sn->model >= 0) {
+            out[n++] = sn->model;
+        } else {
+            stack[top++] = sn->right;
+            stack[top++] = sn->left;
+        }
+    }
+
+    return n;
+}
+
+// Distance along the ray to where it enters a box, or INFINITY if it misses it.
+static float _ray_box(struct Vector3 origin, struct Vector3 inv_direction, struct Vector3 min, struct Vector3 max) {
+    float tx0 = (min.x - origin.x) * inv_direction.x;
+    float tx1 = (max.x - origin.x) * inv_direction.x;
+    float ty0 = (min.y - origin.y) * inv_direction.y;
+    float ty1 = (max.y - origin.y) * inv_direction.y;
+    float tz0 = (min.z - origin.z) * inv_direction.z;
+    float tz1 = (max.z - origin.z) * inv_direction.z;
+
+    float t_enter = MAX(MAX(MIN(tx0, tx1), MIN(ty0, ty1)), MAX(MIN(tz0, tz1), 0));
+    float t_exit  = MIN(MIN(MAX(tx0, tx1), MAX(ty0, ty1)), MAX(tz0, tz1));
+
+    return t_enter <= t_exit ? t_enter : INFINITY;
+}
+
+// Closest hit of a ray with a model's triangles (either side), in model space (Moller-Trumbore).
+static float _ray_model(const struct Model *m, struct Vector3 origin, struct Vector3 direction, float t_max) {
+    float best = t_max;
+    float direction_norm_squared = Vector3_norm_squared(direction);
+    const struct ModelLod *lod = &m->lods[0]; // Rays hit the full detail mesh.
+
+    for (int j = 0; j < lod->num_meshlets; ++j) {
+        const struct Meshlet *ml = &lod->meshlets[j];
+
+        // Skip meshlets whose bounding sphere the ray's line misses.
+        struct Vector3 to_center = Vector3_sub(ml->center, origin);
+        float along = Vector3_dot(to_center, direction);
+        if (Vector3_norm_squared(to_center) * direction_norm_squared - along * along > ml->radius * ml->radius * direction_norm_squared) {
+            continue;
+        }
+
+        for (int i = ml->first_tri; i < ml->first_tri + ml->num_tris; ++i) {
+            struct Vector3 p0 = m->vertices[lod->indices[3 * i + 0]].pos;
+            struct Vector3 p1 = m->vertices[lod->indices[3 * i + 1]].pos;
+            struct Vector3 p2 = m->vertices[lod->indices[3 * i + 2]].pos;
+
+            struct Vector3 e1 = Vector3_sub(p1, p0);
+            struct Vector3 e2 = Vector3_sub(p2, p0);
+            struct Vector3 p  = Vector3_cross(direction, e2);
+            float det = Vector3_dot(e1, p);
+            if (det == 0) {
+                continue; // Parallel.
+            }
+
+            float det_inv = 1 / det;
+            struct Vector3 s = Vector3_sub(origin, p0);
+            float u = Vector3_dot(s, p) * det_inv;
+            if (u < 0 || u > 1) {
+                continue;
+            }
+
+            struct Vector3 q = Vector3_cross(s, e1);
+            float v = Vector3_dot(direction, q) * det_inv;
+            if (v < 0 || u + v > 1) {
+                continue;
+            }
+
+            float t = Vector3_dot(e2, q) * det_inv;
+            if (t >= 0 && t < best) {
+                best = t;
+            }
+        }
+    }
+
+    return best;
+}
+
+int Scene_raycast(const struct Scene *s, struct Vector3 origin, struct Vector3 direction, float *t) {
+    *t = INFINITY;
+    if (s->num_nodes == 0) {
+        return -1;
+    }
+
+    origin.w    = 1;
+    direction.w = 0;
+    struct Vector3 inv_direction = {1 / direction.x, 1 / direction.y, 1 / direction.z, 0};
+
+    int stack[SCENE_MAX_DEPTH];
+    int top  = 0;
+    int best = -1;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        const struct SceneNode *sn = &s->nodes[stack[--top]];
+
+        if (_ray_box(origin, inv_direction, sn->min, sn->max) >= *t) {
+            continue;
+        }
+
+        if (sn->model >= 0) {
+            // Affine transforms keep distances along the ray in units of direction.
+            const struct Model *m = s->models[sn->model];
+            struct Matrix4 model_inv;
+            Matrix4_inverse(&m->model_to_world, &model_inv);
+
+            float hit = _ray_model(m, Matrix4_vmul(&model_inv, origin), Matrix4_vmul(&model_inv, direction), *t);
+            if (hit < *t) {
+                *t   = hit;
+                best = sn->model;
+            }
+        } else {
+            // Visit the nearer child first, so the farther one is more likely to be pruned.
+            float t_left  = _ray_box(origin, inv_direction, s->nodes[sn->left].min,  s->nodes[sn->left].max);
+            float t_right = _ray_box(origin, inv_direction, s->nodes[sn->right].min, s->nodes[sn->right].max);
+            if (t_left < t_right) {
+                stack[top++] = sn->right;
+                stack[top++] = sn->left;
+            } else {
+                stack[top++] = sn->left;
+                stack[top++] = sn->right;
+            }
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,78 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "model.h"
+#include "instances.h"
+#include "clip.h"
+#include "util.h"
+
+// Deepest the BVH gets (median splits keep it within log2 of the number of models, plus one).
+#define SCENE_MAX_DEPTH 64
+
+// A node of the scene's bounding volume hierarchy. Leaves hold a single model.
+struct SceneNode {
+    // World space bounds of everything below the node.
+    struct Vector3 min;
+    struct Vector3 max;
+
+    int parent; // -1 at the root.
+    int left;   // Children, -1 in leaves.
+    int right;
+    int model;  // Index of the model in leaves, -1 otherwise.
+};
+
+// A collection of models, with a BVH over their world space bounds for culling and queries.
+struct Scene {
+    struct Model **models;
+    int            num_models;
+    int            models_capacity;
+
+    struct SceneNode *nodes;
+    int               num_nodes;
+    int              *leaves; // Leaf node of each model.
+
+    // Whether the BVH has been built over every model. Adding a model clears it, and the next
+    // Scene_update rebuilds the BVH. Otherwise updates only refit the nodes above moved models.
+    int built;
+
+    // Instanced meshes, culled per instance rather than through the BVH (see instances.h).
+    struct Instances **instances;
+    int                num_instances;
+    int                instances_capacity;
+};
+
+// We move Scene instances with heap pointers.
+
+struct Scene *Scene_create();
+void          Scene_destroy(struct Scene *s); // Destroys the models and instances as well.
+
+// Takes ownership of the model and returns its index.
+int           Scene_add(struct Scene *s, struct Model *m);
+
+// Takes ownership of the instances and returns their index.
+int           Scene_add_instances(struct Scene *s, struct Instances *inst);
+
+// Brings the BVH up to date with the models' transforms. Call before queries after models moved
+// (see Model_translate, Model_rotate and Model_scale).
+void          Scene_update(struct Scene *s);
+
+// World space bounds of every model and instance (as of the last Scene_update). Returns 0 if the
+// scene is empty.
+int           Scene_bounds(const struct Scene *s, struct Vector3 *min, struct Vector3 *max);
+
+// Queries. Results are model indices, and out must have room for num_models of them.
+
+// Models whose bounds are not entirely outside the frustum planes (see Clip_frustum_planes).
+int           Scene_frustum_query(const struct Scene *s, const struct Vector3 planes[6], int *out);
+
+// Models whose bounds contain the point.
+int           Scene_point_query(const struct Scene *s, struct Vector3 point, int *out);
+
+// Closest model a ray hits (by triangle), or -1. The distance along the ray, in units of
+// direction, goes to t.
+int           Scene_raycast(const struct Scene *s, struct Vector3 origin, struct Vector3 direction, float *t);
+
+#endif
@@ -0,0 +1,89 @@
+#include "thread_pool.h"
+
+struct _Worker {
+    struct ThreadPool *pool;
+    int thread;
+};
+
+static void _drain(struct ThreadPool *p, int thread) {
+    int job;
+    while ((job = SDL_AtomicAdd(&p->next_job, 1)) < p->num_jobs) {
+        p->job_fn(p->ctx, job, thread);
+    }
+}
+
+static int _worker_main(void *data) {
+    struct _Worker *w = data;
+    struct ThreadPool *p = w->pool;
+
+    for (;;) {
+        SDL_SemWait(p->start);
+        if (p->quit) break;
+
+        _drain(p, w->thread);
+        SDL_SemPost(p->done);
+    }
+
+    free(w);
+    return 0;
+}
+
+struct ThreadPool *ThreadPool_create(int num_threads) {
+    struct ThreadPool *p = malloc(sizeof(struct ThreadPool));
+
+    p->num_threads = MAX(1, num_threads);
+    p->start       = SDL_CreateSemaphore(0);
+    p->done        = SDL_CreateSemaphore(0);
+    p->job_fn      = NULL;
+    p->ctx         = NULL;
+    p->num_jobs    = 0;
+    p->num_woken   = 0;
+    p->quit        = 0;
+    SDL_AtomicSet(&p->next_job, 0);
+
+    // Thread 0 is the caller of ThreadPool_run, so we only spawn the rest.
+    p->threads = malloc(sizeof(SDL_Thread *) * p->num_threads);
+    p->threads[0] = NULL;
+    for (int i = 1; i < p->num_threads; ++i) {
+        struct _Worker *w = malloc(sizeof(struct _Worker));
+        w->pool   = p;
+        w->thread = i;
+        p->threads[i] = SDL_CreateThread(_worker_main, "impromptu-worker", w);
+    }
+
+    return p;
+}
+
+void ThreadPool_destroy(struct ThreadPool *p) {
+    p->quit = 1;
+    for (int i = 1; i < p->num_threads; ++i) SDL_SemPost(p->start);
+    for (int i = 1; i < p->num_threads; ++i) SDL_WaitThread(p->threads[i], NULL);
+
+    SDL_DestroySemaphore(p->start);
+    SDL_DestroySemaphore(p->done);
+    free(p->threads);
+    free(p);
+}
+
+void ThreadPool_run(struct ThreadPool *p, ThreadPool_job job_fn, void *ctx, int num_jobs) {
+    ThreadPool_start(p, job_fn, ctx, num_jobs);
+    ThreadPool_wait(p);
+}
+
+void ThreadPool_start(struct ThreadPool *p, ThreadPool_job job_fn, void *ctx, int num_jobs) {
+    p->job_fn   = job_fn;
+    p->ctx      = ctx;
+    p->num_jobs = num_jobs;
+    SDL_AtomicSet(&p->next_job, 0);
+
+    // Only wake as many workers as there is work for (the caller takes one job at least).
+    p->num_woken = MIN(p->num_threads - 1, num_jobs - 1);
+    for (int i = 0; i < p->num_woken; ++i) SDL_SemPost(p->start);
+}
+
+void ThreadPool_wait(struct ThreadPool *p) {
+    _drain(p, 0);
+
+    for (int i = 0; i < p->num_woken; ++i) SDL_SemWait(p->done);
+    p->num_woken = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdlib.h>
+
+#include <SDL2/SDL.h>
+
+#include "util.h"
+
+// A job function is called once per job index. The thread index is in [0, num_threads)
+// and can be used to address per-thread scratch memory.
+typedef void (*ThreadPool_job)(void *ctx, int job, int thread);
+
+struct ThreadPool {
+    // Includes the calling thread, which also works on jobs.
+    int num_threads;
+
+    SDL_Thread **threads;
+    SDL_sem     *start;
+    SDL_sem     *done;
+
+    // Current batch of jobs. Jobs are claimed dynamically so that uneven jobs balance out.
+    ThreadPool_job job_fn;
+    void          *ctx;
+    int            num_jobs;
+    SDL_atomic_t   next_job;
+    int            num_woken;
+
+    int quit;
+};
+
+// We move ThreadPool instances with heap pointers.
+
+struct ThreadPool *ThreadPool_create(int num_threads);
+void               ThreadPool_destroy(struct ThreadPool *p);
+
+// Runs job_fn for every job in [0, num_jobs) and returns once all of them are done.
+void               ThreadPool_run(struct ThreadPool *p, ThreadPool_job job_fn, void *ctx, int num_jobs);
+
+// Same as ThreadPool_run, split in two so the caller can do other work while the workers start on
+// the jobs. ThreadPool_wait has the caller help with what's left and returns once all are done.
+// Only one batch can be in flight.
+void               ThreadPool_start(struct ThreadPool *p, ThreadPool_job job_fn, void *ctx, int num_jobs);
+void               ThreadPool_wait(struct ThreadPool *p);
+
+#endif
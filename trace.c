@@ -0,0 +1,89 @@
+#include "trace.h"
+
+// A thread's spans. Only the thread itself writes to its ring, so it doesn't need any locking.
+struct _TraceRing {
+    struct TraceSpan *spans;     // Allocated with the thread's first span.
+    Uint64            num_spans; // Ever recorded. The last TRACE_RING_SIZE of them are kept.
+};
+
+static struct _TraceRing _rings[TRACE_MAX_THREADS];
+
+void Trace_span(const char *name, int thread, Uint64 start, Uint64 end) {
+    if (thread < 0 || thread >= TRACE_MAX_THREADS) {
+        return;
+    }
+
+    struct _TraceRing *ring = &_rings[thread];
+    if (!ring->spans) {
+        ring->spans = malloc(sizeof(struct TraceSpan) * TRACE_RING_SIZE);
+        if (!ring->spans) {
+            return;
+        }
+    }
+
+    struct TraceSpan *span = &ring->spans[ring->num_spans++ & (TRACE_RING_SIZE - 1)];
+    span->name  = name;
+    span->start = start;
+    span->end   = end;
+}
+
+int Trace_dump(const char *file_name) {
+    static int num_dumps = 0;
+
+    char numbered[32];
+    if (!file_name) {
+        snprintf(numbered, sizeof(numbered), "trace_%03d.json", num_dumps++);
+        file_name = numbered;
+    }
+
+    FILE *f = fopen(file_name, "w");
+    if (!f) {
+        printf("Trace_dump: Couldn't open %s.\n", file_name);
+        return -1;
+    }
+
+    // Timestamps are in microseconds, from the earliest span kept.
+    Uint64 origin = 0;
+    int    found  = 0;
+    for (int t = 0; t < TRACE_MAX_THREADS; ++t) {
+        const struct _TraceRing *ring = &_rings[t];
+        Uint64 first = ring->num_spans > TRACE_RING_SIZE ? ring->num_spans - TRACE_RING_SIZE : 0;
+        for (Uint64 i = first; i < ring->num_spans; ++i) {
+            Uint64 start = ring->spans[i & (TRACE_RING_SIZE - 1)].start;
+            if (!found || start < origin) {
+                origin = start;
+                found  = 1;
+            }
+        }
+    }
+    double us_per_tick = 1e6 / SDL_GetPerformanceFrequency();
+
+    int num_events = 0;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (int t = 0; t < TRACE_MAX_THREADS; ++t) {
+        const struct _TraceRing *ring = &_rings[t];
+        if (ring->num_spans == 0) {
+            continue;
+        }
+
+        fprintf(f, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+            num_events++ ? "," : "", t, t == 0 ? "main" : "worker", t);
+
+        Uint64 first = ring->num_spans > TRACE_RING_SIZE ? ring->num_spans - TRACE_RING_SIZE : 0;
+        for (Uint64 i = first; i < ring->num_spans; ++i) {
+            const struct TraceSpan *span = &ring->spans[i & (TRACE_RING_SIZE - 1)];
+            fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                span->name, t, (span->start - origin) * us_per_tick, (span->end - span->start) * us_per_tick);
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed) {
+        printf("Trace_dump: Couldn't write %s.\n", file_name);
+        return -1;
+    }
+
+    printf("Trace_dump: Wrote %s.\n", file_name);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <SDL2/SDL.h>
+
+#include "util.h"
+
+// Most threads spans are recorded for. Spans of threads past it are dropped.
+#define TRACE_MAX_THREADS 64
+
+// Spans each thread keeps (a power of two). Once a thread's ring is full, its oldest spans are
+// overwritten, so a dump has the last few seconds of every thread.
+#define TRACE_RING_SIZE (1 << 16)
+
+// Timing spans, dumped as Chrome trace events (load the file in chrome://tracing or Perfetto).
+//
+// Spans are only recorded in builds with IMPROMPTU_TRACE defined (-DIMPROMPTU_TRACE). Otherwise the
+// macros below expand to nothing, and cost nothing.
+//
+// Each thread records into its own ring, addressed by its thread pool index (the main thread is 0,
+// see ThreadPool_job), so recording takes no locks. Dumping reads every ring, so it has to happen
+// while only the dumping thread records (between frames).
+//
+//     TRACE_BEGIN(raster);
+//     ...
+//     TRACE_END(raster, "raster", thread);
+//
+// Spans of a thread nest as long as they end in reverse order of beginning.
+
+#ifdef IMPROMPTU_TRACE
+#define TRACE_BEGIN(span)               Uint64 _trace_##span = SDL_GetPerformanceCounter()
+#define TRACE_END(span, name, thread)   Trace_span((name), (thread), _trace_##span, SDL_GetPerformanceCounter())
+#define TRACE_DUMP(file_name)           Trace_dump(file_name)
+#else
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, name, thread)
+#define TRACE_DUMP(file_name)
+#endif
+
+// A span of time a thread spent on something.
+struct TraceSpan {
+    const char *name; // Not copied, so it has to outlive the trace (string literals do).
+    Uint64      start; // In SDL_GetPerformanceCounter ticks.
+    Uint64      end;
+};
+
+// Records a span for a thread.
+void Trace_span(const char *name, int thread, Uint64 start, Uint64 end);
+
+// Writes every thread's recorded spans to a file as Chrome trace event JSON, or to trace_000.json,
+// trace_001.json and so on if file_name is NULL. Returns 0 on success, or -1 if the file couldn't be
+// written.
+int  Trace_dump(const char *file_name);
+
+#endif